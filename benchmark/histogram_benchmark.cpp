@@ -0,0 +1,136 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// compares per-window and dense extraction of the histogram features over
+// the tracking candidates, at a range of search radii
+
+#include "Config.h"
+#include "HistogramFeatures.h"
+#include "ImageRep.h"
+#include "Sample.h"
+#include "Sampler.h"
+#include "Rect.h"
+
+#include <opencv/cv.h>
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace Eigen;
+using namespace cv;
+using namespace std;
+
+static const int kFrameWidth = 320;
+static const int kFrameHeight = 240;
+static const int kBlockSize = 256;
+static const int kNumRepeats = 5;
+
+static Mat MakeFrame()
+{
+    Mat frame(kFrameHeight, kFrameWidth, CV_8UC1);
+    srand(0);
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        for (int x = 0; x < frame.cols; ++x)
+        {
+            frame.at<uchar>(y, x) = (uchar)(rand() % 256);
+        }
+    }
+    return frame;
+}
+
+// time to extract the features of every sample, in milliseconds, with the
+// image rebuilt each time so nothing is reused between repeats
+static double Extract(const HistogramFeatures& features, ImageRep& image, const Mat& frame, const IntRect& region,
+                      const vector<FloatRect>& rects, FeatureMatrix& featVecs)
+{
+    double best = 0.0;
+    for (int r = 0; r < kNumRepeats; ++r)
+    {
+        image.Update(frame, region);
+        MultiSample sample(image, rects);
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        for (int start = 0; start < (int)rects.size(); start += kBlockSize)
+        {
+            int end = min(start+kBlockSize, (int)rects.size());
+            features.Eval(sample, start, end, featVecs.middleRows(start, end-start));
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now()-t0).count();
+        if (r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    Config conf;
+    HistogramFeatures perWindow(conf, false);
+    HistogramFeatures dense(conf, true);
+
+    Mat frame = MakeFrame();
+    IntRect imageRect(0, 0, frame.cols, frame.rows);
+    FloatRect bb(kFrameWidth/2-20, kFrameHeight/2-25, 40, 50);
+
+    ImageRep image(false, true);
+    int radii[] = {10, 20, 30, 45, 60};
+    cout << "radius\twindows\tper-window ms\tdense ms\tspeedup\tmax diff" << endl;
+    for (int i = 0; i < (int)(sizeof(radii)/sizeof(radii[0])); ++i)
+    {
+        int radius = radii[i];
+        vector<FloatRect> rects = Sampler::PixelSamples(bb, radius);
+        // keep only the windows inside the frame, as the tracker does, and
+        // build the image over just the region they cover
+        vector<FloatRect> inside;
+        int x0 = kFrameWidth, y0 = kFrameHeight, x1 = 0, y1 = 0;
+        for (int j = 0; j < (int)rects.size(); ++j)
+        {
+            if (!rects[j].IsInside(imageRect)) continue;
+            inside.push_back(rects[j]);
+            x0 = min(x0, (int)rects[j].XMin());
+            y0 = min(y0, (int)rects[j].YMin());
+            x1 = max(x1, (int)rects[j].XMax());
+            y1 = max(y1, (int)rects[j].YMax());
+        }
+        IntRect region(x0, y0, x1-x0, y1-y0);
+
+        FeatureMatrix a(inside.size(), perWindow.GetCount());
+        FeatureMatrix b(inside.size(), dense.GetCount());
+        double msPerWindow = Extract(perWindow, image, frame, region, inside, a);
+        double msDense = Extract(dense, image, frame, region, inside, b);
+        double diff = (a-b).cwiseAbs().maxCoeff();
+
+        cout << radius << "\t" << inside.size() << "\t" << msPerWindow << "\t" << msDense << "\t"
+             << msPerWindow/msDense << "\t" << diff << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
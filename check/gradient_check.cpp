@@ -0,0 +1,170 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// checks that the support vector gradients the learner updates incrementally
+// match a full recompute, for each kind of feature and kernel, over a
+// synthetic sequence. exits with a failure code if any do not.
+
+#include "Config.h"
+#include "HaarFeatures.h"
+#include "HistogramFeatures.h"
+#include "ImageRep.h"
+#include "Kernels.h"
+#include "LaRank.h"
+#include "MultiFeatures.h"
+#include "RawFeatures.h"
+#include "Sample.h"
+#include "Sampler.h"
+#include "Rect.h"
+
+#include <opencv/cv.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+static const int kFrameWidth = 320;
+static const int kFrameHeight = 240;
+static const int kNumFrames = 60;
+static const int kBudgetSize = 20;
+// megabytes, enough for the minimum 16 support vectors
+static const double kSmallCacheSize = 0.001;
+
+// a textured square moving over a textured background
+static FloatRect MakeFrame(int t, Mat& frame)
+{
+    frame.create(kFrameHeight, kFrameWidth, CV_8UC1);
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        for (int x = 0; x < frame.cols; ++x)
+        {
+            unsigned int h = (x*73856093u) ^ (y*19349663u);
+            frame.at<uchar>(y, x) = (uchar)(60 + ((x/7 + y/5) % 3)*30 + h % 17);
+        }
+    }
+    int cx = 140 + (int)(40*sin(t*0.15));
+    int cy = 95 + (int)(25*cos(t*0.11));
+    for (int y = 0; y < 50; ++y)
+    {
+        for (int x = 0; x < 40; ++x)
+        {
+            frame.at<uchar>(cy+y, cx+x) = (uchar)(((x/5 + y/5) % 2) ? 230 : 20);
+        }
+    }
+    return FloatRect((float)cx, (float)cy, 40.f, 50.f);
+}
+
+// runs the learner over the sequence, returning whether the gradients
+// matched after every update
+static bool Check(const string& name, const Config& conf, const Features& features, const Kernel& kernel)
+{
+    mt19937 rng(conf.seed);
+    LaRank learner(conf, features, kernel, rng);
+    ImageRep image(true, true);
+    IntRect imageRect(0, 0, kFrameWidth, kFrameHeight);
+
+    double maxError = 0.0;
+    bool ok = true;
+    Mat frame;
+    for (int t = 0; t < kNumFrames; ++t)
+    {
+        FloatRect bb = MakeFrame(t, frame);
+        image.Update(frame);
+
+        // as Tracker::UpdateLearner, with the true box as the centre sample
+        vector<FloatRect> rects = Sampler::RadialSamples(bb, 2*conf.searchRadius, 5, 16);
+        vector<FloatRect> keptRects;
+        keptRects.push_back(rects[0]);
+        for (int i = 1; i < (int)rects.size(); ++i)
+        {
+            if (rects[i].IsInside(imageRect)) keptRects.push_back(rects[i]);
+        }
+        learner.Update(MultiSample(image, keptRects), 0);
+
+        double error;
+        if (!learner.CheckGradients(error))
+        {
+            cerr << name << ": gradient error " << error << " at frame " << t << endl;
+            ok = false;
+        }
+        maxError = max(maxError, error);
+    }
+
+    // with a budget every pattern comes from the pool allocated up front
+    if (conf.svmBudgetSize > 0 && learner.GetPatternsAllocated() > conf.svmBudgetSize+2)
+    {
+        cerr << name << ": " << learner.GetPatternsAllocated() << " patterns allocated" << endl;
+        ok = false;
+    }
+
+    cout << name << ": max gradient error " << maxError
+         << ", patterns " << learner.GetPatternsInUse() << "/" << learner.GetPatternsAllocated()
+         << ", support vectors " << learner.GetSupportVectorsInUse() << "/" << learner.GetSupportVectorCapacity()
+         << (ok ? "" : " FAILED") << endl;
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    Config conf;
+    conf.quietMode = true;
+    conf.svmBudgetSize = kBudgetSize;
+
+    HaarFeatures haar(conf);
+    RawFeatures raw(conf);
+    HistogramFeatures hist(conf);
+    GaussianKernel gaussian(0.2);
+    IntersectionKernel intersection;
+    LinearKernel linear;
+
+    bool ok = true;
+    ok &= Check("haar gaussian", conf, haar, gaussian);
+    ok &= Check("histogram intersection", conf, hist, intersection);
+    ok &= Check("raw linear", conf, raw, linear);
+
+    PairFeatures<HaarFeatures, HistogramFeatures> haarHist(haar, hist);
+    PairKernel<GaussianKernel, IntersectionKernel> haarHistKernel(gaussian, intersection, haar.GetCount(), hist.GetCount());
+    ok &= Check("haar gaussian + histogram intersection", conf, haarHist, haarHistKernel);
+
+    // without a budget the gradients are updated without the pattern caches
+    conf.svmBudgetSize = 0;
+    ok &= Check("haar gaussian, no budget", conf, haar, gaussian);
+
+    // and once the kernel cache is full, support vectors are removed as for
+    // the budget. unbudgeted runs settle at a few dozen, so the cap is set
+    // below that
+    conf.svmCacheSize = kSmallCacheSize;
+    ok &= Check("haar gaussian, no budget, small cache", conf, haar, gaussian);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,188 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// checks that a MultiTracker follows every target exactly as independent
+// Trackers with the same configuration would, over a synthetic sequence.
+// exits with a failure code if any box differs.
+
+#include "Config.h"
+#include "MultiTracker.h"
+#include "Tracker.h"
+#include "Rect.h"
+
+#include <opencv/cv.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+static const int kFrameWidth = 320;
+static const int kFrameHeight = 240;
+static const int kNumFrames = 30;
+// the target added part way through the sequence
+static const int kLateFrame = 10;
+
+// two textured squares moving over a textured background
+static void MakeFrame(int t, Mat& frame)
+{
+    frame.create(kFrameHeight, kFrameWidth, CV_8UC1);
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        for (int x = 0; x < frame.cols; ++x)
+        {
+            unsigned int h = (x*73856093u) ^ (y*19349663u);
+            frame.at<uchar>(y, x) = (uchar)(60 + ((x/7 + y/5) % 3)*30 + h % 17);
+        }
+    }
+    int cx = 100 + (int)(40*sin(t*0.15));
+    int cy = 90 + (int)(25*cos(t*0.11));
+    for (int y = 0; y < 50; ++y)
+    {
+        for (int x = 0; x < 40; ++x)
+        {
+            frame.at<uchar>(cy+y, cx+x) = (uchar)(((x/5 + y/5) % 2) ? 230 : 20);
+        }
+    }
+    cx = 230 + (int)(20*cos(t*0.2));
+    cy = 150;
+    for (int y = 0; y < 30; ++y)
+    {
+        for (int x = 0; x < 30; ++x)
+        {
+            frame.at<uchar>(cy+y, cx+x) = (uchar)((x/3 + y/6) % 2 ? 200 : 40);
+        }
+    }
+}
+
+// tracks the targets both ways, returning whether every box matched. the
+// last target is only added at kLateFrame
+static bool Check(const string& name, const Config& conf, const vector<FloatRect>& bbs)
+{
+    MultiTracker multi(conf);
+    vector<Tracker*> trackers;
+    for (int i = 0; i < (int)bbs.size(); ++i)
+    {
+        trackers.push_back(new Tracker(conf));
+    }
+    int numEarly = (int)bbs.size()-1;
+
+    bool ok = true;
+    Mat frame;
+    for (int t = 0; t < kNumFrames && ok; ++t)
+    {
+        MakeFrame(t, frame);
+        if (t == 0)
+        {
+            multi.AddTargets(frame, vector<FloatRect>(bbs.begin(), bbs.begin()+numEarly));
+        }
+        else
+        {
+            multi.Track(frame);
+        }
+        if (t == kLateFrame)
+        {
+            multi.AddTarget(frame, bbs.back());
+        }
+
+        for (int i = 0; i < (int)trackers.size(); ++i)
+        {
+            int start = i < numEarly ? 0 : kLateFrame;
+            if (t < start) continue;
+            if (t == start)
+            {
+                trackers[i]->Initialise(frame, bbs[i]);
+            }
+            else
+            {
+                trackers[i]->Track(frame);
+            }
+
+            const FloatRect& a = multi.GetBB(i);
+            const FloatRect& b = trackers[i]->GetBB();
+            if (a.XMin() != b.XMin() || a.YMin() != b.YMin() ||
+                a.Width() != b.Width() || a.Height() != b.Height())
+            {
+                cerr << name << ": target " << i << " at frame " << t << " is " << a
+                     << ", tracked alone it is " << b << endl;
+                ok = false;
+            }
+        }
+    }
+
+    for (int i = 0; i < (int)trackers.size(); ++i)
+    {
+        delete trackers[i];
+    }
+
+    cout << name << ": " << multi.GetTargetCount() << " targets" << (ok ? "" : " FAILED") << endl;
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    Config conf;
+    conf.quietMode = true;
+    conf.frameWidth = kFrameWidth;
+    conf.frameHeight = kFrameHeight;
+    conf.svmBudgetSize = 20;
+    conf.numThreads = 2;
+
+    // the first two are the same size and overlap, so their candidate
+    // windows are shared. the third is the same size but apart from them,
+    // and the last is a different size
+    vector<FloatRect> bbs;
+    bbs.push_back(FloatRect(100, 115, 40, 50));
+    bbs.push_back(FloatRect(108, 120, 40, 50));
+    bbs.push_back(FloatRect(20, 170, 40, 50));
+    bbs.push_back(FloatRect(250, 150, 30, 30));
+
+    Config::FeatureKernelPair haar;
+    haar.feature = Config::kFeatureTypeHaar;
+    haar.kernel = Config::kKernelTypeGaussian;
+    haar.params.push_back(0.2);
+    Config::FeatureKernelPair hist;
+    hist.feature = Config::kFeatureTypeHistogram;
+    hist.kernel = Config::kKernelTypeIntersection;
+
+    bool ok = true;
+    conf.features.assign(1, haar);
+    ok &= Check("haar gaussian", conf, bbs);
+
+    conf.features.push_back(hist);
+    ok &= Check("haar gaussian + histogram intersection", conf, bbs);
+
+    conf.svmBudgetSize = 0;
+    conf.features.assign(1, haar);
+    ok &= Check("haar gaussian, no budget", conf, bbs);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
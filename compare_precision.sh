@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# build struck in double and single precision, run the experiments with each
+# and print the average IoU per sequence side by side
+if [[ $# -eq 1 ]]
+then
+    random_seed=$1
+else
+    random_seed=0
+fi
+
+# color codes for script output
+error_color='\033[1;31m'
+no_color='\033[0m'
+
+source_dir=$(cd "$(dirname "$0")" && pwd)
+sequences=("coke11" "david" "faceocc" "faceocc2" "girl" "sylv" "tiger1" "tiger2")
+precisions=("double" "single")
+
+for p in ${precisions[@]}
+do
+    build_dir="${source_dir}/build_${p}"
+    if [[ ${p} == "single" ]]
+    then
+        single="ON"
+    else
+        single="OFF"
+    fi
+    mkdir -p ${build_dir}
+    (cd ${build_dir} && cmake -DCMAKE_BUILD_TYPE=Release -DSTRUCK_SINGLE_PRECISION=${single} ${source_dir} && make)
+    if [[ ! $? -eq 0 ]]
+    then
+        >&2 echo -e "${error_color}error: failed to build ${p} precision${no_color}"
+        exit 1
+    fi
+    start=${SECONDS}
+    (cd ${build_dir}/bin && ./run_experiments.sh ${random_seed})
+    echo $((SECONDS-start)) > ${build_dir}/bin/time.txt
+done
+
+# average IoU as written by analyze
+average_iou()
+{
+    if [[ -f $1 ]]
+    then
+        sed -n 's/^average: //p' $1
+    else
+        echo "-"
+    fi
+}
+
+echo "---------------------------------------------------"
+printf "%-10s %10s %10s\n" "video" "double" "single"
+for s in ${sequences[@]}
+do
+    printf "%-10s %10s %10s\n" ${s} \
+        $(average_iou ${source_dir}/build_double/bin/${s}.ious) \
+        $(average_iou ${source_dir}/build_single/bin/${s}.ious)
+done
+printf "%-10s %10s %10s\n" "time (s)" \
+    $(cat ${source_dir}/build_double/bin/time.txt) \
+    $(cat ${source_dir}/build_single/bin/time.txt)
@@ -65,6 +65,9 @@ Config::Config(const std::string& path)
         else if (name == "searchRadius") iss >> searchRadius;
         else if (name == "svmC") iss >> svmC;
         else if (name == "svmBudgetSize") iss >> svmBudgetSize;
+        else if (name == "svmCacheSize") iss >> svmCacheSize;
+        else if (name == "numThreads") iss >> numThreads;
+        else if (name == "fourierFeatureCount") iss >> fourierFeatureCount;
         else if (name == "feature")
         {
             string featureName, kernelName;
@@ -123,6 +126,9 @@ void Config::SetDefaults()
     searchRadius = 30;
     svmC = 1.0;
     svmBudgetSize = 0;
+    svmCacheSize = 32.0;
+    numThreads = 1;
+    fourierFeatureCount = 0;
 
     features.clear();
 }
@@ -162,17 +168,20 @@ std::string Config::KernelName(KernelType k)
 ostream& operator<< (ostream& out, const Config& conf)
 {
     out << "config:" << endl;
-    out << "  quietMode          = " << conf.quietMode << endl;
-    out << "  debugMode          = " << conf.debugMode << endl;
-    out << "  sequenceBasePath   = " << conf.sequenceBasePath << endl;
-    out << "  sequenceName       = " << conf.sequenceName << endl;
-    out << "  resultsPath        = " << conf.resultsPath << endl;
-    out << "  frameWidth         = " << conf.frameWidth << endl;
-    out << "  frameHeight        = " << conf.frameHeight << endl;
-    out << "  seed               = " << conf.seed << endl;
-    out << "  searchRadius       = " << conf.searchRadius << endl;
-    out << "  svmC               = " << conf.svmC << endl;
-    out << "  svmBudgetSize      = " << conf.svmBudgetSize << endl;
+    out << "  quietMode           = " << conf.quietMode << endl;
+    out << "  debugMode           = " << conf.debugMode << endl;
+    out << "  sequenceBasePath    = " << conf.sequenceBasePath << endl;
+    out << "  sequenceName        = " << conf.sequenceName << endl;
+    out << "  resultsPath         = " << conf.resultsPath << endl;
+    out << "  frameWidth          = " << conf.frameWidth << endl;
+    out << "  frameHeight         = " << conf.frameHeight << endl;
+    out << "  seed                = " << conf.seed << endl;
+    out << "  searchRadius        = " << conf.searchRadius << endl;
+    out << "  svmC                = " << conf.svmC << endl;
+    out << "  svmBudgetSize       = " << conf.svmBudgetSize << endl;
+    out << "  svmCacheSize        = " << conf.svmCacheSize << endl;
+    out << "  numThreads          = " << conf.numThreads << endl;
+    out << "  fourierFeatureCount = " << conf.fourierFeatureCount << endl;
 
     for (int i = 0; i < (int)conf.features.size(); ++i)
     {
@@ -76,6 +76,9 @@ public:
     int                             searchRadius;
     double                          svmC;
     int                             svmBudgetSize;
+    double                          svmCacheSize;
+    int                             numThreads;
+    int                             fourierFeatureCount;
     std::vector<FeatureKernelPair>  features;
 
     friend std::ostream& operator<< (std::ostream& out, const Config& conf);
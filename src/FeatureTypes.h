@@ -0,0 +1,45 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FEATURE_TYPES_H
+#define FEATURE_TYPES_H
+
+#include <Eigen/Core>
+
+// scalar type used for feature vectors and kernel values. single precision
+// doubles the simd width of the kernel loops and halves their memory traffic;
+// the svm dual variables and gradients are always kept in double.
+#if STRUCK_SINGLE_PRECISION
+typedef float FeatureScalar;
+#else
+typedef double FeatureScalar;
+#endif
+
+typedef Eigen::Matrix<FeatureScalar, Eigen::Dynamic, 1> FeatureVector;
+typedef Eigen::Matrix<FeatureScalar, Eigen::Dynamic, Eigen::Dynamic> FeatureMatrix;
+
+#endif
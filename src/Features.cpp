@@ -28,6 +28,7 @@
 #include "Features.h"
 
 using namespace Eigen;
+using namespace std;
 
 Features::Features() :
     m_featureCount(0)
@@ -37,5 +38,16 @@ Features::Features() :
 void Features::SetCount(int c)
 {
     m_featureCount = c;
-    m_featVec = VectorXd::Zero(c);
+}
+
+void Features::Eval(const MultiSample& s, vector<FeatureVector>& featVecs) const
+{
+    int n = (int)s.GetRects().size();
+    FeatureMatrix X(n, m_featureCount);
+    Eval(s, 0, n, X);
+    featVecs.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        featVecs[i] = X.row(i).transpose();
+    }
 }
@@ -28,6 +28,7 @@
 #ifndef FEATURES_H
 #define FEATURES_H
 
+#include "FeatureTypes.h"
 #include "Sample.h"
 
 #include <Eigen/Core>
@@ -39,31 +40,33 @@ public:
     Features();
     virtual ~Features() {}
 
-    inline const Eigen::VectorXd& Eval(const Sample& s) const
+    inline void Eval(const Sample& s, Eigen::Ref<FeatureVector> featVec) const
     {
-        const_cast<Features*>(this)->UpdateFeatureVector(s);
-        return m_featVec;
+        UpdateFeatureVector(s, featVec);
     }
 
-    virtual void Eval(const MultiSample& s, std::vector<Eigen::VectorXd>& featVecs)
+    // evaluate samples [start, end) into the rows of featVecs
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const
     {
         // default implementation
-        featVecs.resize(s.GetRects().size());
-        for (int i = 0; i < (int)featVecs.size(); ++i)
+        FeatureVector featVec(m_featureCount);
+        for (int i = start; i < end; ++i)
         {
-            featVecs[i] = Eval(s.GetSample(i));
+            Eval(s.GetSample(i), featVec);
+            featVecs.row(i-start) = featVec.transpose();
         }
     }
 
+    void Eval(const MultiSample& s, std::vector<FeatureVector>& featVecs) const;
+
     inline int GetCount() const { return m_featureCount; }
 
 protected:
 
     int m_featureCount;
-    Eigen::VectorXd m_featVec;
 
     void SetCount(int c);
-    virtual void UpdateFeatureVector(const Sample& s) = 0;
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const = 0;
 
 };
 
@@ -0,0 +1,79 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FourierFeatures.h"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <random>
+
+using namespace Eigen;
+using namespace std;
+
+FourierFeatures::FourierFeatures(Features* features, double sigma, int count, int seed) :
+    m_features(features),
+    m_projection(count, features->GetCount()),
+    m_phase(count),
+    m_scale((FeatureScalar)sqrt(2.0/count))
+{
+    SetCount(count);
+
+    // draw the projection up front so it only depends on the seed
+    mt19937 rng(seed);
+    normal_distribution<double> normal(0.0, sqrt(2.0*sigma));
+    uniform_real_distribution<double> uniform(0.0, 2.0*M_PI);
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = 0; j < m_projection.cols(); ++j)
+        {
+            m_projection(i, j) = normal(rng);
+        }
+        m_phase[i] = uniform(rng);
+    }
+}
+
+FourierFeatures::~FourierFeatures()
+{
+    delete m_features;
+}
+
+void FourierFeatures::Eval(const MultiSample& s, int start, int end, Ref<FeatureMatrix> featVecs) const
+{
+    FeatureMatrix X(end-start, m_features->GetCount());
+    m_features->Eval(s, start, end, X);
+    featVecs.noalias() = X*m_projection.transpose();
+    featVecs.rowwise() += m_phase.transpose();
+    featVecs = m_scale*featVecs.array().cos();
+}
+
+void FourierFeatures::UpdateFeatureVector(const Sample& s, Ref<FeatureVector> featVec) const
+{
+    FeatureVector x(m_features->GetCount());
+    m_features->Eval(s, x);
+    featVec.noalias() = m_projection*x;
+    featVec = m_scale*(featVec + m_phase).array().cos();
+}
@@ -0,0 +1,58 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FOURIER_FEATURES_H
+#define FOURIER_FEATURES_H
+
+#include "Features.h"
+
+#include <Eigen/Core>
+
+// random fourier features (Rahimi & Recht, NIPS 2007): maps the base features
+// x to z(x) = sqrt(2/D) cos(Wx + b), with the rows of W drawn from N(0, 2 sigma I)
+// and b uniform in [0, 2 pi), so that a linear kernel on z approximates the
+// gaussian kernel exp(-sigma |x1-x2|^2) on x.
+class FourierFeatures : public Features
+{
+public:
+    // takes ownership of features
+    FourierFeatures(Features* features, double sigma, int count, int seed);
+    ~FourierFeatures();
+
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const;
+
+private:
+    Features* m_features;
+    FeatureMatrix m_projection;
+    FeatureVector m_phase;
+    FeatureScalar m_scale;
+
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const;
+};
+
+#endif
@@ -122,4 +122,22 @@ float HaarFeature::Eval(const Sample& s) const
         value += m_weights[i]*image.Sum(sampleRect);
     }
     return value / (m_factor*roi.Area()*m_bb.Area());
+}
+
+float HaarFeature::Compile(float width, float height, int step, vector<int>& offsets, vector<int>& weights) const
+{
+    // rounding matches Eval for a window with its origin on the pixel grid
+    FloatRect roi(0.f, 0.f, width, height);
+    for (int i = 0; i < (int)m_rects.size(); ++i)
+    {
+        const FloatRect& r = m_rects[i];
+        IntRect sampleRect((int)(roi.XMin()+r.XMin()*roi.Width()+0.5f), (int)(roi.YMin()+r.YMin()*roi.Height()+0.5f),
+            (int)(r.Width()*roi.Width()), (int)(r.Height()*roi.Height()));
+        offsets.push_back(sampleRect.YMin()*step + sampleRect.XMin());
+        offsets.push_back(sampleRect.YMin()*step + sampleRect.XMax());
+        offsets.push_back(sampleRect.YMax()*step + sampleRect.XMin());
+        offsets.push_back(sampleRect.YMax()*step + sampleRect.XMax());
+        weights.push_back((int)m_weights[i]);
+    }
+    return m_factor*roi.Area()*m_bb.Area();
 }
\ No newline at end of file
@@ -43,6 +43,12 @@ public:
 
     float Eval(const Sample& s) const;
 
+    // compile the feature for windows of the given size: appends four corner
+    // offsets per rectangle (relative to the window origin in an integral image
+    // with rows of step elements) and an integer weight per rectangle, and
+    // returns the normalisation which Eval divides the weighted sum by
+    float Compile(float width, float height, int step, std::vector<int>& offsets, std::vector<int>& weights) const;
+
 private:
     FloatRect m_bb;
     std::vector<FloatRect> m_rects;
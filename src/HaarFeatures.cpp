@@ -28,6 +28,10 @@
 #include "HaarFeatures.h"
 #include "Config.h"
 
+using namespace Eigen;
+using namespace cv;
+using namespace std;
+
 static const int kSystematicFeatureCount = 192;
 
 HaarFeatures::HaarFeatures(const Config& conf)
@@ -57,10 +61,104 @@ void HaarFeatures::GenerateSystematic()
     }
 }
 
-void HaarFeatures::UpdateFeatureVector(const Sample& s)
+void HaarFeatures::UpdateFeatureVector(const Sample& s, Ref<FeatureVector> featVec) const
 {
     for (int i = 0; i < m_featureCount; ++i)
     {
-        m_featVec[i] = m_features[i].Eval(s);
+        featVec[i] = m_features[i].Eval(s);
+    }
+}
+
+shared_ptr<const HaarFeatures::Layout> HaarFeatures::GetLayout(float width, float height, int step) const
+{
+    lock_guard<mutex> lock(m_layoutMutex);
+    if (!m_pLayout || m_pLayout->width != width || m_pLayout->height != height || m_pLayout->step != step)
+    {
+        Layout* layout = new Layout;
+        layout->width = width;
+        layout->height = height;
+        layout->step = step;
+        for (int i = 0; i < m_featureCount; ++i)
+        {
+            layout->rectStarts.push_back((int)layout->weights.size());
+            layout->norms.push_back(m_features[i].Compile(width, height, step, layout->offsets, layout->weights));
+        }
+        layout->rectStarts.push_back((int)layout->weights.size());
+        m_pLayout.reset(layout);
+    }
+    return m_pLayout;
+}
+
+void HaarFeatures::Eval(const MultiSample& s, int start, int end, Ref<FeatureMatrix> featVecs) const
+{
+    const vector<FloatRect>& rects = s.GetRects();
+    const Mat& integral = s.GetImage().GetIntegralImage();
+    const IntRect& imageRect = s.GetImage().GetRect();
+    int step = (int)integral.step1();
+    shared_ptr<const Layout> layout;
+    FeatureVector featVec(m_featureCount);
+    vector<int> values(end-start);
+
+    int i = start;
+    while (i < end)
+    {
+        const FloatRect& roi = rects[i];
+        int x = (int)roi.XMin();
+        int y = (int)roi.YMin();
+        if (x != roi.XMin() || y != roi.YMin())
+        {
+            // rectangles of windows off the pixel grid are rounded individually
+            UpdateFeatureVector(s.GetSample(i), featVec);
+            featVecs.row(i-start) = featVec.transpose();
+            ++i;
+            continue;
+        }
+
+        if (!layout || layout->width != roi.Width() || layout->height != roi.Height())
+        {
+            layout = GetLayout(roi.Width(), roi.Height(), step);
+        }
+
+        // windows one pixel apart along a row (as produced by PixelSamples)
+        // are evaluated together, sweeping each feature along the row so
+        // that both the integral image reads and the output are contiguous
+        int n = 1;
+        while (i+n < end && rects[i+n].YMin() == roi.YMin() && rects[i+n].XMin() == roi.XMin()+n &&
+            rects[i+n].Width() == roi.Width() && rects[i+n].Height() == roi.Height())
+        {
+            ++n;
+        }
+
+        const int* origin = integral.ptr<int>(y-imageRect.YMin()) + x-imageRect.XMin();
+        for (int j = 0; j < m_featureCount; ++j)
+        {
+            int* v = &values[0];
+            for (int k = 0; k < n; ++k)
+            {
+                v[k] = 0;
+            }
+            for (int r = layout->rectStarts[j]; r < layout->rectStarts[j+1]; ++r)
+            {
+                const int* o = &layout->offsets[4*r];
+                const int* p0 = origin + o[0];
+                const int* p1 = origin + o[1];
+                const int* p2 = origin + o[2];
+                const int* p3 = origin + o[3];
+                int w = layout->weights[r];
+                for (int k = 0; k < n; ++k)
+                {
+                    v[k] += w*(p0[k] - p1[k] - p2[k] + p3[k]);
+                }
+            }
+
+            float norm = layout->norms[j];
+            FeatureScalar* out = &featVecs(i-start, j);
+            for (int k = 0; k < n; ++k)
+            {
+                out[k] = (float)v[k]/norm;
+            }
+        }
+
+        i += n;
     }
 }
@@ -31,19 +31,41 @@
 #include "Features.h"
 #include "HaarFeature.h"
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 class Config;
 
-class HaarFeatures : public Features
+class HaarFeatures final : public Features
 {
 public:
     HaarFeatures(const Config& conf);
 
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const;
+
 private:
+    // all features compiled for one window size into flat tables, see
+    // HaarFeature::Compile. the rectangles of feature i are
+    // [rectStarts[i], rectStarts[i+1])
+    struct Layout
+    {
+        float width;
+        float height;
+        int step;
+        std::vector<int> rectStarts;
+        std::vector<int> offsets;
+        std::vector<int> weights;
+        std::vector<float> norms;
+    };
+
     std::vector<HaarFeature> m_features;
+    mutable std::mutex m_layoutMutex;
+    mutable std::shared_ptr<const Layout> m_pLayout;
 
-    virtual void UpdateFeatureVector(const Sample& s);
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const;
+    std::shared_ptr<const Layout> GetLayout(float width, float height, int step) const;
 
     void GenerateSystematic();
 };
@@ -30,18 +30,62 @@
 #include "Sample.h"
 #include "Rect.h"
 
+#include <climits>
 #include <iostream>
 
 using namespace Eigen;
 using namespace cv;
 using namespace std;
 
-static const int kNumBins = 16;
+static const int kNumBins = ImageRep::kNumBins;
 static const int kNumLevels = 4;
+static const int kNumCells = 1+4+9+16;
 static const int kNumCellsX = 3;
 static const int kNumCellsY = 3;
+static const int kLevelStart[kNumLevels+1] = {0, 1, 5, 14, 30};
+static const int kMaxMaps = 8;
 
-HistogramFeatures::HistogramFeatures(const Config& conf)
+// the cells of every level of the window, in feature order
+static void GetCells(const FloatRect& roi, IntRect* cells)
+{
+    int histind = 0;
+    for (int il = 0; il < kNumLevels; ++il)
+    {
+        int nc = il+1;
+        float w = roi.Width()/nc;
+        float h = roi.Height()/nc;
+        FloatRect cell(0.f, 0.f, w, h);
+        for (int iy = 0; iy < nc; ++iy)
+        {
+            cell.SetYMin(roi.YMin()+iy*h);
+            for (int ix = 0; ix < nc; ++ix)
+            {
+                cell.SetXMin(roi.XMin()+ix*w);
+                cells[histind] = cell; // note this truncates to integers
+                ++histind;
+            }
+        }
+    }
+}
+
+// whether the cell origins all fall within the maps
+static bool Covers(const vector<IntRect>& origins, const IntRect* cells)
+{
+    for (int il = 0; il < kNumLevels; ++il)
+    {
+        const IntRect& o = origins[il];
+        for (int i = kLevelStart[il]; i < kLevelStart[il+1]; ++i)
+        {
+            int x = cells[i].XMin()-o.XMin();
+            int y = cells[i].YMin()-o.YMin();
+            if (x < 0 || y < 0 || x >= o.Width() || y >= o.Height()) return false;
+        }
+    }
+    return true;
+}
+
+HistogramFeatures::HistogramFeatures(const Config& conf, bool dense) :
+    m_dense(dense)
 {
     int nc = 0;
     for (int i = 0; i < kNumLevels; ++i)
@@ -53,33 +97,153 @@ HistogramFeatures::HistogramFeatures(const Config& conf)
     cout << "histogram bins: " << GetCount() << endl;
 }
 
-void HistogramFeatures::UpdateFeatureVector(const Sample& s)
+void HistogramFeatures::UpdateFeatureVector(const Sample& s, Ref<FeatureVector> featVec) const
 {
-    IntRect rect = s.GetROI(); // note this truncates to integers
     //cv::Rect roi(rect.XMin(), rect.YMin(), rect.Width(), rect.Height());
     //cv::resize(s.GetImage().GetImage(0)(roi), m_patchImage, m_patchImage.size());
 
-    m_featVec.setZero();
-    VectorXd hist(kNumBins);
+    // all the cells are gathered first, so the histograms can be written
+    // straight into the feature vector in one go
+    IntRect cells[kNumCells];
+    GetCells(s.GetROI(), cells);
+    s.GetImage().Hist(cells, kNumCells, featVec.data());
+    featVec /= kNumCells;
+}
 
-    int histind = 0;
+void HistogramFeatures::Eval(const MultiSample& s, int start, int end, Ref<FeatureMatrix> featVecs) const
+{
+    if (!m_dense)
+    {
+        Features::Eval(s, start, end, featVecs);
+        return;
+    }
+
+    const vector<FloatRect>& rects = s.GetRects();
+    shared_ptr<const Maps> maps;
+    IntRect cells[kNumCells];
+    FeatureVector featVec(m_featureCount);
+    for (int i = start; i < end; ++i)
+    {
+        const FloatRect& roi = rects[i];
+        GetCells(roi, cells);
+        if (!maps || maps->width != roi.Width() || maps->height != roi.Height() || (maps->dense && !Covers(maps->origins, cells)))
+        {
+            maps = GetMaps(s, roi, cells);
+        }
+
+        if (!maps->dense)
+        {
+            s.GetImage().Hist(cells, kNumCells, featVec.data());
+            featVec /= kNumCells;
+            featVecs.row(i-start) = featVec.transpose();
+            continue;
+        }
+
+        // the map entries are exactly what Hist gives for the cell
+        for (int il = 0; il < kNumLevels; ++il)
+        {
+            const IntRect& o = maps->origins[il];
+            const FeatureScalar* map = maps->hists[il].data();
+            for (int c = kLevelStart[il]; c < kLevelStart[il+1]; ++c)
+            {
+                const FeatureScalar* h = map + ((cells[c].YMin()-o.YMin())*o.Width() + cells[c].XMin()-o.XMin())*kNumBins;
+                for (int j = 0; j < kNumBins; ++j)
+                {
+                    featVecs(i-start, c*kNumBins+j) = h[j]/kNumCells;
+                }
+            }
+        }
+    }
+}
+
+shared_ptr<const HistogramFeatures::Maps> HistogramFeatures::GetMaps(const MultiSample& s, const FloatRect& roi, const IntRect* cells) const
+{
+    // held while building, so the other threads evaluating the sample wait
+    // for the maps rather than duplicating them
+    lock_guard<mutex> lock(m_mapsMutex);
+
+    unsigned int id = s.GetImage().GetId();
+    for (int i = 0; i < (int)m_maps.size(); ++i)
+    {
+        const Maps& m = *m_maps[i];
+        if (m.imageId == id && m.width == roi.Width() && m.height == roi.Height() && (!m.dense || Covers(m.origins, cells)))
+        {
+            return m_maps[i];
+        }
+    }
+
+    // maps only ever serve the image they were built from
+    for (int i = (int)m_maps.size()-1; i >= 0; --i)
+    {
+        if (m_maps[i]->imageId != id) m_maps.erase(m_maps.begin()+i);
+    }
+    if ((int)m_maps.size() >= kMaxMaps) m_maps.erase(m_maps.begin());
+
+    shared_ptr<Maps> maps(new Maps);
+    maps->imageId = id;
+    maps->width = roi.Width();
+    maps->height = roi.Height();
+
+    // bounds of the cell origins over every window of this size
+    vector<int> x0(kNumLevels, INT_MAX), y0(kNumLevels, INT_MAX);
+    vector<int> x1(kNumLevels, INT_MIN), y1(kNumLevels, INT_MIN);
+    const vector<FloatRect>& rects = s.GetRects();
+    IntRect windowCells[kNumCells];
+    int numWindows = 0;
+    for (int i = 0; i < (int)rects.size(); ++i)
+    {
+        if (rects[i].Width() != roi.Width() || rects[i].Height() != roi.Height()) continue;
+        GetCells(rects[i], windowCells);
+        for (int il = 0; il < kNumLevels; ++il)
+        {
+            for (int c = kLevelStart[il]; c < kLevelStart[il+1]; ++c)
+            {
+                x0[il] = min(x0[il], windowCells[c].XMin());
+                y0[il] = min(y0[il], windowCells[c].YMin());
+                x1[il] = max(x1[il], windowCells[c].XMin());
+                y1[il] = max(y1[il], windowCells[c].YMin());
+            }
+        }
+        ++numWindows;
+    }
+
+    int numPoints = 0;
     for (int il = 0; il < kNumLevels; ++il)
     {
-        int nc = il+1;
-        float w = s.GetROI().Width()/nc;
-        float h = s.GetROI().Height()/nc;
-        FloatRect cell(0.f, 0.f, w, h);
-        for (int iy = 0; iy < nc; ++iy)
+        maps->origins.push_back(IntRect(x0[il], y0[il], x1[il]-x0[il]+1, y1[il]-y0[il]+1));
+        numPoints += maps->origins[il].Area();
+    }
+
+    // each map entry costs about as much as one cell of one window, and the
+    // gather about as much again, so the maps only pay off when the windows
+    // overlap well, as the dense grid of tracking candidates does but the
+    // sparse learner samples do not
+    maps->dense = 2*numPoints < numWindows*kNumCells;
+    if (maps->dense)
+    {
+        maps->hists.resize(kNumLevels);
+        vector<IntRect> rowCells;
+        for (int il = 0; il < kNumLevels; ++il)
         {
-            cell.SetYMin(s.GetROI().YMin()+iy*h);
-            for (int ix = 0; ix < nc; ++ix)
+            const IntRect& o = maps->origins[il];
+            const IntRect& cell = cells[kLevelStart[il]];
+            maps->hists[il].resize(o.Area()*kNumBins);
+            rowCells.resize(o.Width());
+            for (int y = 0; y < o.Height(); ++y)
             {
-                cell.SetXMin(s.GetROI().XMin()+ix*w);
-                s.GetImage().Hist(cell, hist);
-                m_featVec.segment(histind*kNumBins, kNumBins) = hist;
-                ++histind;
+                for (int x = 0; x < o.Width(); ++x)
+                {
+                    rowCells[x] = IntRect(o.XMin()+x, o.YMin()+y, cell.Width(), cell.Height());
+                }
+                s.GetImage().Hist(&rowCells[0], o.Width(), &maps->hists[il][y*o.Width()*kNumBins]);
             }
         }
     }
-    m_featVec /= histind;
+    else
+    {
+        maps->origins.clear();
+    }
+
+    m_maps.push_back(maps);
+    return maps;
 }
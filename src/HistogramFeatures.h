@@ -29,17 +29,45 @@
 #define HISTOGRAM_FEATURES_H
 
 #include "Features.h"
+#include "Rect.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class Config;
 
-class HistogramFeatures : public Features
+class HistogramFeatures final : public Features
 {
 public:
-    HistogramFeatures(const Config& conf);
+    // in dense mode the cell histograms of each level are computed once
+    // for every cell position the windows of a MultiSample use, and the
+    // window features gathered from those maps
+    HistogramFeatures(const Config& conf, bool dense = true);
+
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const;
 
 private:
+    // the cell histograms at each level for windows of one size, indexed by
+    // cell origin within origins[level]
+    struct Maps
+    {
+        unsigned int imageId;
+        float width;
+        float height;
+        bool dense;
+        std::vector<IntRect> origins;
+        std::vector<std::vector<FeatureScalar> > hists;
+    };
+
+    bool m_dense;
+    mutable std::mutex m_mapsMutex;
+    mutable std::vector<std::shared_ptr<const Maps> > m_maps;
+
+    std::shared_ptr<const Maps> GetMaps(const MultiSample& s, const FloatRect& roi, const IntRect* cells) const;
 
-    virtual void UpdateFeatureVector(const Sample& s);
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const;
 };
 
 #endif
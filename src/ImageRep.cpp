@@ -27,33 +27,96 @@
 
 #include "ImageRep.h"
 
+#include <atomic>
 #include <cassert>
+#include <cstring>
 
 #include <opencv/highgui.h>
 
 using namespace std;
 using namespace cv;
 
-static const int kNumBins = 16;
+ImageRep::ImageRep(bool computeIntegral, bool computeIntegralHist, bool colour) :
+    m_channels(colour ? 3 : 1),
+    m_computeIntegral(computeIntegral),
+    m_computeIntegralHist(computeIntegralHist),
+    m_tiledHist(false),
+    m_id(0)
+{
+    m_images.resize(m_channels);
+    if (computeIntegral)
+    {
+        m_integralBuffers.resize(m_channels);
+        m_integralImages.resize(m_channels);
+    }
+}
 
 ImageRep::ImageRep(const Mat& image, bool computeIntegral, bool computeIntegralHist, bool colour) :
-    m_channels(colour ? 3 : 1),
-    m_rect(0, 0, image.cols, image.rows)
+    ImageRep(computeIntegral, computeIntegralHist, colour)
+{
+    Update(image);
+}
+
+ImageRep::ImageRep(const Mat& image, const IntRect& roi, bool computeIntegral, bool computeIntegralHist, bool colour) :
+    ImageRep(computeIntegral, computeIntegralHist, colour)
 {
-    for (int i = 0; i < m_channels; ++i)
+    Update(image, roi);
+}
+
+// integral histograms over more points than this are stored tiled, as 16
+// bit sums local to tiles of kHistTileSize, which cannot overflow as a tile
+// holds at most 128*128 pixels
+static const int kMaxFlatHistPoints = 512*512;
+static const int kHistTileSize = 128;
+
+// point view at the top left of buffer, growing buffer only when it is too small
+static void GetView(Mat& buffer, Mat& view, int rows, int cols, int type = CV_32SC1)
+{
+    if (buffer.rows < rows || buffer.cols < cols)
     {
-        m_images.push_back(Mat(image.rows, image.cols, CV_8UC1));
-        if (computeIntegral) m_integralImages.push_back(Mat(image.rows+1, image.cols+1, CV_32SC1));
-        if (computeIntegralHist)
-        {
-            for (int j = 0; j < kNumBins; ++j)
-            {
-                m_integralHistImages.push_back(Mat(image.rows+1, image.cols+1, CV_32SC1));
-            }
-        }
+        buffer.create(max(buffer.rows, rows), max(buffer.cols, cols), type);
+    }
+    view = buffer(cv::Rect(0, 0, cols, rows));
+}
+
+void ImageRep::Update(const Mat& image)
+{
+    Update(image, IntRect(0, 0, image.cols, image.rows));
+}
+
+void ImageRep::Update(const Mat& image, const IntRect& roi)
+{
+    static atomic<unsigned int> nextId(0);
+    m_id = ++nextId;
+
+    int x0 = max(roi.XMin(), 0);
+    int y0 = max(roi.YMin(), 0);
+    int x1 = min(roi.XMax(), image.cols);
+    int y1 = min(roi.YMax(), image.rows);
+    m_rect.Set(x0, y0, max(x1-x0, 0), max(y1-y0, 0));
+
+    int width = m_rect.Width();
+    int height = m_rect.Height();
+    for (int i = 0; i < (int)m_integralImages.size(); ++i)
+    {
+        GetView(m_integralBuffers[i], m_integralImages[i], height+1, width+1);
+    }
+    m_tiledHist = (width+1)*(height+1) > kMaxFlatHistPoints;
+    if (m_computeIntegralHist && m_tiledHist)
+    {
+        GetView(m_localHistBuffer, m_localHist, height+1, (width+1)*kNumBins, CV_16UC1);
+        GetView(m_histTopBuffer, m_histTop, height/kHistTileSize+1, (width+1)*kNumBins);
+        GetView(m_histLeftBuffer, m_histLeft, width/kHistTileSize+1, (height+1)*kNumBins);
+        m_histRows.resize(2*(width+1)*kNumBins);
+    }
+    else if (m_computeIntegralHist)
+    {
+        GetView(m_integralHistBuffer, m_integralHist, height+1, (width+1)*kNumBins);
     }
 
-    if (colour)
+    // the grey images are converted in place, and only reallocated when
+    // the frame size changes
+    if (m_channels == 3)
     {
         assert(image.channels() == 3);
         split(image, m_images);
@@ -71,58 +134,176 @@ ImageRep::ImageRep(const Mat& image, bool computeIntegral, bool computeIntegralH
         }
     }
 
-    if (computeIntegral)
+    cv::Rect rect(m_rect.XMin(), m_rect.YMin(), width, height);
+    if (m_computeIntegral)
     {
         for (int i = 0; i < m_channels; ++i)
         {
             //equalizeHist(m_images[i], m_images[i]);
-            integral(m_images[i], m_integralImages[i]);
+            integral(m_images[i](rect), m_integralImages[i]);
         }
     }
 
-    if (computeIntegralHist)
+    if (m_computeIntegralHist)
     {
-        Mat tmp(image.rows, image.cols, CV_8UC1);
-        tmp.setTo(0);
-        for (int j = 0; j < kNumBins; ++j)
+        // all the bin integrals are accumulated in a single pass over the
+        // image, with the bin of each grey level looked up rather than
+        // computed per pixel. the bins of each pixel are interleaved, so
+        // each step adds a contiguous run of kNumBins running sums to the
+        // row above
+        uchar bins[256];
+        for (int v = 0; v < 256; ++v)
         {
-            for (int y = 0; y < image.rows; ++y)
+            bins[v] = (uchar)(((float)v/256)*kNumBins);
+        }
+
+        // when tiled, only two rows of the full 32 bit integral are kept, and
+        // each row is split into the tiled form as it is finished
+        int rowLength = (width+1)*kNumBins;
+        for (int y = 0; y <= height; ++y)
+        {
+            int* cur = m_tiledHist ? &m_histRows[(y%2)*rowLength] : m_integralHist.ptr<int>(y);
+            if (y == 0)
+            {
+                memset(cur, 0, rowLength*sizeof(int));
+            }
+            else
             {
-                const uchar* src = m_images[0].ptr(y);
-                uchar* dst = tmp.ptr(y);
-                for (int x = 0; x < image.cols; ++x)
+                const int* prev = m_tiledHist ? &m_histRows[((y-1)%2)*rowLength] : m_integralHist.ptr<int>(y-1);
+                const uchar* src = m_images[0].ptr(m_rect.YMin()+y-1) + m_rect.XMin();
+                int sums[kNumBins] = {0};
+                for (int j = 0; j < kNumBins; ++j)
                 {
-                    int bin = (int)(((float)*src/256)*kNumBins);
-                    *dst = (bin == j) ? 1 : 0;
-                    ++src;
-                    ++dst;
+                    cur[j] = 0;
+                }
+                for (int x = 0; x < width; ++x)
+                {
+                    ++sums[bins[src[x]]];
+                    int* dst = cur + (x+1)*kNumBins;
+                    const int* above = prev + (x+1)*kNumBins;
+                    for (int j = 0; j < kNumBins; ++j)
+                    {
+                        dst[j] = above[j]+sums[j];
+                    }
                 }
             }
+            if (!m_tiledHist) continue;
 
-            integral(tmp, m_integralHistImages[j]);
+            int* top = m_histTop.ptr<int>(y/kHistTileSize);
+            if (y%kHistTileSize == 0)
+            {
+                memcpy(top, cur, rowLength*sizeof(int));
+            }
+            ushort* local = m_localHist.ptr<ushort>(y);
+            for (int x0 = 0; x0 <= width; x0 += kHistTileSize)
+            {
+                int* left = m_histLeft.ptr<int>(x0/kHistTileSize) + y*kNumBins;
+                for (int j = 0; j < kNumBins; ++j)
+                {
+                    left[j] = cur[x0*kNumBins+j]-top[x0*kNumBins+j];
+                }
+                int x1 = min(x0+kHistTileSize, width+1);
+                for (int i = x0*kNumBins; i < x1*kNumBins; i += kNumBins)
+                {
+                    for (int j = 0; j < kNumBins; ++j)
+                    {
+                        local[i+j] = (ushort)(cur[i+j]-top[i+j]-left[j]);
+                    }
+                }
+            }
         }
     }
 }
 
 int ImageRep::Sum(const IntRect& rRect, int channel) const
 {
-    assert(rRect.XMin() >= 0 && rRect.YMin() >= 0 && rRect.XMax() <= m_images[0].cols && rRect.YMax() <= m_images[0].rows);
-    return m_integralImages[channel].at<int>(rRect.YMin(), rRect.XMin()) +
-            m_integralImages[channel].at<int>(rRect.YMax(), rRect.XMax()) -
-            m_integralImages[channel].at<int>(rRect.YMax(), rRect.XMin()) -
-            m_integralImages[channel].at<int>(rRect.YMin(), rRect.XMax());
+    assert(rRect.IsInside(m_rect));
+    int x0 = rRect.XMin()-m_rect.XMin();
+    int y0 = rRect.YMin()-m_rect.YMin();
+    int x1 = rRect.XMax()-m_rect.XMin();
+    int y1 = rRect.YMax()-m_rect.YMin();
+    return m_integralImages[channel].at<int>(y0, x0) +
+            m_integralImages[channel].at<int>(y1, x1) -
+            m_integralImages[channel].at<int>(y1, x0) -
+            m_integralImages[channel].at<int>(y0, x1);
+}
+
+void ImageRep::Hist(const IntRect& rRect, FeatureVector& h) const
+{
+    Hist(&rRect, 1, h.data());
+}
+
+void ImageRep::Hist(const IntRect* rects, int count, FeatureScalar* h) const
+{
+    for (int r = 0; r < count; ++r, h += kNumBins)
+    {
+        const IntRect& rect = rects[r];
+        assert(rect.IsInside(m_rect));
+        int x0 = rect.XMin()-m_rect.XMin();
+        int y0 = rect.YMin()-m_rect.YMin();
+        int x1 = rect.XMax()-m_rect.XMin();
+        int y1 = rect.YMax()-m_rect.YMin();
+
+        int sums[kNumBins];
+        if (!m_tiledHist)
+        {
+            const int* p00 = m_integralHist.ptr<int>(y0) + x0*kNumBins;
+            const int* p01 = m_integralHist.ptr<int>(y0) + x1*kNumBins;
+            const int* p10 = m_integralHist.ptr<int>(y1) + x0*kNumBins;
+            const int* p11 = m_integralHist.ptr<int>(y1) + x1*kNumBins;
+            for (int j = 0; j < kNumBins; ++j)
+            {
+                sums[j] = p00[j] + p11[j] - p10[j] - p01[j];
+            }
+        }
+        else
+        {
+            HistTiled(x0, y0, x1, y1, sums);
+        }
+
+        int norm = rect.Area();
+        for (int j = 0; j < kNumBins; ++j)
+        {
+            h[j] = (float)sums[j]/norm;
+        }
+    }
 }
 
-void ImageRep::Hist(const IntRect& rRect, Eigen::VectorXd& h) const
+void ImageRep::HistTiled(int x0, int y0, int x1, int y1, int* sums) const
 {
-    assert(rRect.XMin() >= 0 && rRect.YMin() >= 0 && rRect.XMax() <= m_images[0].cols && rRect.YMax() <= m_images[0].rows);
-    int norm = rRect.Area();
-    for (int i = 0; i < kNumBins; ++i)
+    // the full integral at each corner is top+left+local, but the top
+    // anchors cancel when both rows fall in the same row of tiles, as do
+    // the left anchors for columns in the same column of tiles
+    const ushort* l00 = m_localHist.ptr<ushort>(y0) + x0*kNumBins;
+    const ushort* l01 = m_localHist.ptr<ushort>(y0) + x1*kNumBins;
+    const ushort* l10 = m_localHist.ptr<ushort>(y1) + x0*kNumBins;
+    const ushort* l11 = m_localHist.ptr<ushort>(y1) + x1*kNumBins;
+    for (int j = 0; j < kNumBins; ++j)
     {
-        int sum = m_integralHistImages[i].at<int>(rRect.YMin(), rRect.XMin()) +
-            m_integralHistImages[i].at<int>(rRect.YMax(), rRect.XMax()) -
-            m_integralHistImages[i].at<int>(rRect.YMax(), rRect.XMin()) -
-            m_integralHistImages[i].at<int>(rRect.YMin(), rRect.XMax());
-        h[i] = (float)sum/norm;
+        sums[j] = (int)l00[j] + (int)l11[j] - (int)l10[j] - (int)l01[j];
+    }
+    int ty0 = y0/kHistTileSize;
+    int ty1 = y1/kHistTileSize;
+    if (ty0 != ty1)
+    {
+        const int* t00 = m_histTop.ptr<int>(ty0) + x0*kNumBins;
+        const int* t01 = m_histTop.ptr<int>(ty0) + x1*kNumBins;
+        const int* t10 = m_histTop.ptr<int>(ty1) + x0*kNumBins;
+        const int* t11 = m_histTop.ptr<int>(ty1) + x1*kNumBins;
+        for (int j = 0; j < kNumBins; ++j)
+        {
+            sums[j] += t00[j] + t11[j] - t10[j] - t01[j];
+        }
+    }
+    int tx0 = x0/kHistTileSize;
+    int tx1 = x1/kHistTileSize;
+    if (tx0 != tx1)
+    {
+        const int* left0 = m_histLeft.ptr<int>(tx0);
+        const int* left1 = m_histLeft.ptr<int>(tx1);
+        for (int j = 0; j < kNumBins; ++j)
+        {
+            sums[j] += left0[y0*kNumBins+j] + left1[y1*kNumBins+j] - left0[y1*kNumBins+j] - left1[y0*kNumBins+j];
+        }
     }
 }
@@ -28,6 +28,7 @@
 #ifndef IMAGE_REP_H
 #define IMAGE_REP_H
 
+#include "FeatureTypes.h"
 #include "Rect.h"
 
 #include <opencv/cv.h>
@@ -38,20 +39,62 @@
 class ImageRep
 {
 public:
+    // an empty representation, to be filled by Update
+    ImageRep(bool computeIntegral, bool computeIntegralHists, bool colour = false);
     ImageRep(const cv::Mat& rImage, bool computeIntegral, bool computeIntegralHists, bool colour = false);
+    // only builds the integral images for the part of the image inside roi,
+    // which is all that Sum and Hist can then be used on
+    ImageRep(const cv::Mat& rImage, const IntRect& roi, bool computeIntegral, bool computeIntegralHists, bool colour = false);
+
+    // rebuild in place from a new frame, reusing the existing buffers
+    // whenever they are large enough
+    void Update(const cv::Mat& rImage);
+    void Update(const cv::Mat& rImage, const IntRect& roi);
 
     int Sum(const IntRect& rRect, int channel = 0) const;
-    void Hist(const IntRect& rRect, Eigen::VectorXd& h) const;
+    void Hist(const IntRect& rRect, FeatureVector& h) const;
+    // the histograms of count rectangles, one after another in h
+    void Hist(const IntRect* rects, int count, FeatureScalar* h) const;
+
+    static const int kNumBins = 16;
 
     inline const cv::Mat& GetImage(int channel = 0) const { return m_images[channel]; }
+    // note the integral images cover GetRect(), so are offset from the image
+    inline const cv::Mat& GetIntegralImage(int channel = 0) const { return m_integralImages[channel]; }
+    // the region samples can be taken from
     inline const IntRect& GetRect() const { return m_rect; }
+    // differs after every Update, so data derived from the image can be cached
+    inline unsigned int GetId() const { return m_id; }
 
 private:
     std::vector<cv::Mat> m_images;
+    // the integral images are views onto the top left of their buffers,
+    // which only ever grow
     std::vector<cv::Mat> m_integralImages;
-    std::vector<cv::Mat> m_integralHistImages;
+    std::vector<cv::Mat> m_integralBuffers;
+    // the integral histogram holds the kNumBins bins of each point side by
+    // side. over large regions it is split into tiles to halve its size:
+    // m_localHist then holds 16 bit sums from the corner of each point's
+    // tile, and the 32 bit anchors make up the rest. m_histTop is the full
+    // integral along the top row of each row of tiles, and m_histLeft the
+    // sums down the left column of each column of tiles, from the tile's top
+    cv::Mat m_integralHist;
+    cv::Mat m_integralHistBuffer;
+    cv::Mat m_localHist;
+    cv::Mat m_histTop;
+    cv::Mat m_histLeft;
+    cv::Mat m_localHistBuffer;
+    cv::Mat m_histTopBuffer;
+    cv::Mat m_histLeftBuffer;
+    std::vector<int> m_histRows;
     int m_channels;
+    bool m_computeIntegral;
+    bool m_computeIntegralHist;
+    bool m_tiledHist;
     IntRect m_rect;
+    unsigned int m_id;
+
+    void HistTiled(int x0, int y0, int x1, int y1, int* sums) const;
 };
 
 #endif
@@ -0,0 +1,155 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "IntersectionTable.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace Eigen;
+using namespace std;
+
+IntersectionTable::IntersectionTable(int dim) :
+    m_dims(dim)
+{
+    for (int k = 0; k < dim; ++k)
+    {
+        m_dims[k].sums.push_back(0.0);
+        m_dims[k].betas.push_back(0.0);
+    }
+}
+
+int IntersectionTable::Find(const Dimension& dim, int ind, FeatureScalar value) const
+{
+    int i = (int)(lower_bound(dim.values.begin(), dim.values.end(), value) - dim.values.begin());
+    while (dim.inds[i] != ind)
+    {
+        ++i;
+        assert(i < (int)dim.inds.size() && dim.values[i] == value);
+    }
+    return i;
+}
+
+void IntersectionTable::Add(int ind, const Ref<const FeatureVector>& x)
+{
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        Dimension& dim = m_dims[k];
+        int i = (int)(upper_bound(dim.values.begin(), dim.values.end(), x[k]) - dim.values.begin());
+        dim.values.insert(dim.values.begin()+i, x[k]);
+        dim.inds.insert(dim.inds.begin()+i, ind);
+    }
+}
+
+void IntersectionTable::Remove(int ind, const Ref<const FeatureVector>& x)
+{
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        Dimension& dim = m_dims[k];
+        int i = Find(dim, ind, x[k]);
+        dim.values.erase(dim.values.begin()+i);
+        dim.inds.erase(dim.inds.begin()+i);
+    }
+}
+
+void IntersectionTable::Move(int from, int to, const Ref<const FeatureVector>& x)
+{
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        Dimension& dim = m_dims[k];
+        dim.inds[Find(dim, from, x[k])] = to;
+    }
+}
+
+void IntersectionTable::Update(const vector<double>& betas)
+{
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        Dimension& dim = m_dims[k];
+        int n = (int)dim.values.size();
+
+        // features are often sparse or quantised, so merge repeated values
+        // into a single knot to keep the searches short
+        dim.knots.clear();
+        dim.sums.assign(1, 0.0);
+        dim.betas.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            double b = betas[dim.inds[i]];
+            if (dim.knots.empty() || dim.values[i] != dim.knots.back())
+            {
+                dim.knots.push_back(dim.values[i]);
+                dim.sums.push_back(dim.sums.back());
+                dim.betas.push_back(b);
+            }
+            else
+            {
+                dim.betas.back() += b;
+            }
+            dim.sums.back() += b*dim.values[i];
+        }
+
+        // sums[j] = sum of b*s over knots before j, betas[j] = sum of b
+        // over knots from j onwards
+        dim.betas.push_back(0.0);
+        for (int j = (int)dim.knots.size()-1; j >= 0; --j)
+        {
+            dim.betas[j] += dim.betas[j+1];
+        }
+    }
+}
+
+double IntersectionTable::Eval(const Ref<const FeatureVector>& x) const
+{
+    double f = 0.0;
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        const Dimension& dim = m_dims[k];
+        int j = CountNotGreater(dim.knots, x[k]);
+        f += dim.sums[j] + x[k]*dim.betas[j];
+    }
+    return f;
+}
+
+void IntersectionTable::Eval(const Ref<const FeatureMatrix>& X, double* results) const
+{
+    int n = (int)X.rows();
+    for (int i = 0; i < n; ++i)
+    {
+        results[i] = 0.0;
+    }
+    for (int k = 0; k < (int)m_dims.size(); ++k)
+    {
+        const Dimension& dim = m_dims[k];
+        const FeatureScalar* x = X.col(k).data();
+        for (int i = 0; i < n; ++i)
+        {
+            int j = CountNotGreater(dim.knots, x[i]);
+            results[i] += dim.sums[j] + x[i]*dim.betas[j];
+        }
+    }
+}
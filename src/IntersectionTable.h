@@ -0,0 +1,94 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INTERSECTION_TABLE_H
+#define INTERSECTION_TABLE_H
+
+#include "FeatureTypes.h"
+
+#include <Eigen/Core>
+#include <vector>
+
+// lookup tables for evaluating an intersection kernel svm in O(d log n),
+// (Maji, Berg & Malik, CVPR 2008). the discriminant function
+//   f(x) = sum_i b_i sum_k min(x_k, s_ik) = sum_k h_k(x_k)
+// is additive, and each h_k is piecewise linear in x_k with knots at the
+// support vector values s_ik. these are kept sorted per dimension, along with
+// the running sums which give h_k between each pair of knots.
+class IntersectionTable
+{
+public:
+    IntersectionTable(int dim);
+
+    // support vectors are identified by index, matching the learner
+    void Add(int ind, const Eigen::Ref<const FeatureVector>& x);
+    void Remove(int ind, const Eigen::Ref<const FeatureVector>& x);
+    // the support vector at from, with values x, is now at index to
+    void Move(int from, int to, const Eigen::Ref<const FeatureVector>& x);
+
+    // recompute the running sums, must be called after the support vectors
+    // or their betas change and before the next Eval
+    void Update(const std::vector<double>& betas);
+
+    double Eval(const Eigen::Ref<const FeatureVector>& x) const;
+    // evaluate every row of X into results, one dimension at a time so
+    // that each table is only brought into cache once
+    void Eval(const Eigen::Ref<const FeatureMatrix>& X, double* results) const;
+
+private:
+    struct Dimension
+    {
+        std::vector<FeatureScalar> values;
+        std::vector<int> inds;
+        // the distinct values as knots, and for x between knots[j-1] and
+        // knots[j], h(x) = sums[j] + x*betas[j]
+        std::vector<FeatureScalar> knots;
+        std::vector<double> sums;
+        std::vector<double> betas;
+    };
+
+    std::vector<Dimension> m_dims;
+
+    int Find(const Dimension& dim, int ind, FeatureScalar value) const;
+
+    // number of values <= x, without unpredictable branches
+    static inline int CountNotGreater(const std::vector<FeatureScalar>& values, FeatureScalar x)
+    {
+        int n = (int)values.size();
+        if (n == 0) return 0;
+        const FeatureScalar* base = &values[0];
+        while (n > 1)
+        {
+            int half = n/2;
+            base = (base[half] <= x) ? base+half : base;
+            n -= half;
+        }
+        return (int)(base - &values[0]) + (*base <= x);
+    }
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "KernelCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+
+// never limit the cache to fewer support vectors than this
+static const int kMinCapacity = 16;
+
+KernelCache::KernelCache(int capacity, size_t maxBytes) :
+    m_capacity(0),
+    m_maxCapacity(INT_MAX)
+{
+    if (maxBytes > 0)
+    {
+        // c(c+1)/2 entries for c support vectors
+        double entries = (double)maxBytes/sizeof(FeatureScalar);
+        m_maxCapacity = max(kMinCapacity, (int)((sqrt(8.0*entries+1.0)-1.0)/2.0));
+    }
+    Reserve(min(capacity, m_maxCapacity));
+}
+
+bool KernelCache::Reserve(int n)
+{
+    if (n <= m_capacity) return true;
+    if (n > m_maxCapacity) return false;
+
+    // the packed layout doesn't depend on the capacity, so existing entries
+    // stay where they are
+    int capacity = (int)min(max((long long)n, 2LL*m_capacity), (long long)m_maxCapacity);
+    m_K.resize((size_t)capacity*(capacity+1)/2);
+    m_slots.reserve(capacity);
+    m_freeSlots.reserve(capacity);
+    m_capacity = capacity;
+    return true;
+}
+
+int KernelCache::Add()
+{
+    int slot = (int)m_slots.size();
+    if (!m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    assert(slot < m_capacity);
+    m_slots.push_back(slot);
+    return (int)m_slots.size()-1;
+}
+
+void KernelCache::Remove(int ind)
+{
+    m_freeSlots.push_back(m_slots[ind]);
+    m_slots[ind] = m_slots.back();
+    m_slots.pop_back();
+}
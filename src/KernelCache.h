@@ -0,0 +1,83 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef KERNEL_CACHE_H
+#define KERNEL_CACHE_H
+
+#include "FeatureTypes.h"
+
+#include <cstddef>
+#include <vector>
+
+// the kernel between every pair of support vectors. storage starts small and
+// grows geometrically with the number of support vectors, up to an optional
+// memory limit.
+//
+// only the lower triangle is stored, packed row by row. each support vector
+// owns a slot in it for as long as it lives, and support vector indices are
+// mapped to slots, so that reordering support vectors moves no kernel values
+class KernelCache
+{
+public:
+    // maxBytes of 0 means no limit
+    KernelCache(int capacity, size_t maxBytes);
+
+    inline int GetCapacity() const { return m_capacity; }
+
+    // make room for n support vectors, returns false if that would take
+    // more than the memory limit
+    bool Reserve(int n);
+
+    inline FeatureScalar operator()(int i, int j) const
+    {
+        return m_K[Index(m_slots[i], m_slots[j])];
+    }
+
+    inline void Set(int i, int j, FeatureScalar k)
+    {
+        m_K[Index(m_slots[i], m_slots[j])] = k;
+    }
+
+    // append a support vector, whose entries must then be set
+    int Add();
+    // remove support vector ind, the last support vector takes its index
+    void Remove(int ind);
+
+private:
+    std::vector<FeatureScalar> m_K;
+    std::vector<int> m_slots;
+    std::vector<int> m_freeSlots;
+    int m_capacity;
+    int m_maxCapacity;
+
+    static inline size_t Index(int a, int b)
+    {
+        return a >= b ? (size_t)a*(a+1)/2 + b : (size_t)b*(b+1)/2 + a;
+    }
+};
+
+#endif
@@ -28,67 +28,147 @@
 #ifndef KERNELS_H
 #define KERNELS_H
 
+#include "FeatureTypes.h"
+
 #include <Eigen/Core>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 class Kernel
 {
 public:
     virtual ~Kernel() {}
-    virtual double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const = 0;
-    virtual double Eval(const Eigen::VectorXd& x) const = 0;
+    virtual double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const = 0;
+    virtual double Eval(const Eigen::Ref<const FeatureVector>& x) const = 0;
+
+    // evaluate the kernel between every row of X1 and every column of X2,
+    // giving K(i,j) = k(X1.row(i), X2.col(j)). K is sized by the caller, so
+    // it can be a view of a buffer the caller keeps
+    virtual void EvalBatch(const Eigen::Ref<const FeatureMatrix>& X1, const Eigen::Ref<const FeatureMatrix>& X2, Eigen::Ref<FeatureMatrix> K) const
+    {
+        // default implementation
+        if (X1.rows() == 1 && X1.outerStride() == 1)
+        {
+            // a single contiguous row, such as a transposed column, is used
+            // in place
+            Eigen::Map<const FeatureVector> x1(X1.data(), X1.cols());
+            for (int j = 0; j < X2.cols(); ++j)
+            {
+                K(0,j) = Eval(x1, X2.col(j));
+            }
+            return;
+        }
+        FeatureMatrix& x1 = Scratch(kScratchSingle, X1.cols(), 1);
+        for (int i = 0; i < X1.rows(); ++i)
+        {
+            x1.col(0).head(X1.cols()) = X1.row(i).transpose();
+            for (int j = 0; j < X2.cols(); ++j)
+            {
+                K(i,j) = Eval(x1.col(0).head(X1.cols()), X2.col(j));
+            }
+        }
+    }
+
+protected:
+    enum ScratchSlot
+    {
+        kScratchSingle,    // used by the single kernels
+        kScratchComposite, // used by kernels combining others
+        kNumScratchSlots
+    };
+
+    // grow-only scratch space for batch evaluation. it is per thread, as the
+    // tracker evaluates blocks of samples on several threads at once, and
+    // composite kernels use their own slot so the kernels they call can't
+    // overwrite it
+    static FeatureMatrix& Scratch(ScratchSlot slot, int rows, int cols)
+    {
+        static thread_local FeatureMatrix scratch[kNumScratchSlots];
+        FeatureMatrix& m = scratch[slot];
+        if (m.rows() < rows || m.cols() < cols)
+        {
+            m.resize(std::max(rows, (int)m.rows()), std::max(cols, (int)m.cols()));
+        }
+        return m;
+    }
 };
 
-class LinearKernel : public Kernel
+class LinearKernel final : public Kernel
 {
 public:
-    inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
     {
         return x1.dot(x2);
     }
 
-    inline double Eval(const Eigen::VectorXd& x) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
     {
         return x.squaredNorm();
     }
+
+    void EvalBatch(const Eigen::Ref<const FeatureMatrix>& X1, const Eigen::Ref<const FeatureMatrix>& X2, Eigen::Ref<FeatureMatrix> K) const
+    {
+        K.noalias() = X1*X2;
+    }
 };
 
-class GaussianKernel : public Kernel
+class GaussianKernel final : public Kernel
 {
 public:
     GaussianKernel(double sigma) : m_sigma(sigma) {}
-    inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
     {
         return exp(-m_sigma*(x1-x2).squaredNorm());
     }
 
-    inline double Eval(const Eigen::VectorXd& x) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
     {
         return 1.0;
     }
 
+    void EvalBatch(const Eigen::Ref<const FeatureMatrix>& X1, const Eigen::Ref<const FeatureMatrix>& X2, Eigen::Ref<FeatureMatrix> K) const
+    {
+        // expand |x1-x2|^2 = |x1|^2 + |x2|^2 - 2<x1,x2> so that the bulk
+        // of the work is a single matrix-matrix product
+        K.noalias() = X1*X2;
+        K *= FeatureScalar(-2);
+        // the norms are added a row and a column at a time, as broadcasting
+        // them would evaluate each into a temporary vector
+        for (int i = 0; i < K.rows(); ++i)
+        {
+            K.row(i).array() += X1.row(i).squaredNorm();
+        }
+        for (int j = 0; j < K.cols(); ++j)
+        {
+            K.col(j).array() += X2.col(j).squaredNorm();
+        }
+        // clamp small negative distances caused by cancellation
+        K = (FeatureScalar(-m_sigma)*K.array().max(FeatureScalar(0))).exp().matrix();
+    }
+
 private:
     double m_sigma;
 };
 
-class IntersectionKernel : public Kernel
+class IntersectionKernel final : public Kernel
 {
 public:
-    inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
     {
         return x1.array().min(x2.array()).sum();
     }
 
-    inline double Eval(const Eigen::VectorXd& x) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
     {
         return x.sum();
     }
 };
 
-class Chi2Kernel : public Kernel
+class Chi2Kernel final : public Kernel
 {
 public:
-    inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
     {
         double result = 0.0;
         for (int i = 0; i < x1.size(); ++i)
@@ -100,7 +180,7 @@ public:
         return 1.0 - result;
     }
 
-    inline double Eval(const Eigen::VectorXd& x) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
     {
         return 1.0;
     }
@@ -117,7 +197,7 @@ public:
     {
     }
 
-    inline double Eval(const Eigen::VectorXd& x1, const Eigen::VectorXd& x2) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
     {
         double sum = 0.0;
         int start = 0;
@@ -130,7 +210,7 @@ public:
         return sum;
     }
 
-    inline double Eval(const Eigen::VectorXd& x) const
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
     {
         double sum = 0.0;
         int start = 0;
@@ -143,6 +223,20 @@ public:
         return sum;
     }
 
+    void EvalBatch(const Eigen::Ref<const FeatureMatrix>& X1, const Eigen::Ref<const FeatureMatrix>& X2, Eigen::Ref<FeatureMatrix> K) const
+    {
+        K.setZero();
+        Eigen::Ref<FeatureMatrix> Ki = Scratch(kScratchComposite, X1.rows(), X2.cols()).topLeftCorner(X1.rows(), X2.cols());
+        int start = 0;
+        for (int i = 0; i < m_n; ++i)
+        {
+            int c = m_counts[i];
+            m_kernels[i]->EvalBatch(X1.middleCols(start, c), X2.middleRows(start, c), Ki);
+            K += FeatureScalar(m_norm)*Ki;
+            start += c;
+        }
+    }
+
 private:
     int m_n;
     double m_norm;
@@ -151,4 +245,54 @@ private:
 
 };
 
+// the sum of two kernels over consecutive feature ranges, as MultiKernel
+// computes, but with the kernel types known at compile time so the per
+// support vector evaluations inline rather than going through a virtual
+// call and a segment for each
+template <class K1, class K2>
+class PairKernel : public Kernel
+{
+public:
+    PairKernel(const K1& k1, const K2& k2, int count1, int count2) :
+        m_k1(k1),
+        m_k2(k2),
+        m_c1(count1),
+        m_c2(count2),
+        m_norm(0.5)
+    {
+    }
+
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x1, const Eigen::Ref<const FeatureVector>& x2) const
+    {
+        double sum = 0.0;
+        sum += m_norm*m_k1.K1::Eval(x1.head(m_c1), x2.head(m_c1));
+        sum += m_norm*m_k2.K2::Eval(x1.tail(m_c2), x2.tail(m_c2));
+        return sum;
+    }
+
+    inline double Eval(const Eigen::Ref<const FeatureVector>& x) const
+    {
+        double sum = 0.0;
+        sum += m_norm*m_k1.K1::Eval(x.head(m_c1));
+        sum += m_norm*m_k2.K2::Eval(x.tail(m_c2));
+        return sum;
+    }
+
+    void EvalBatch(const Eigen::Ref<const FeatureMatrix>& X1, const Eigen::Ref<const FeatureMatrix>& X2, Eigen::Ref<FeatureMatrix> K) const
+    {
+        Eigen::Ref<FeatureMatrix> Ki = Scratch(kScratchComposite, X1.rows(), X2.cols()).topLeftCorner(X1.rows(), X2.cols());
+        m_k1.K1::EvalBatch(X1.leftCols(m_c1), X2.topRows(m_c1), K);
+        m_k2.K2::EvalBatch(X1.rightCols(m_c2), X2.bottomRows(m_c2), Ki);
+        K *= FeatureScalar(m_norm);
+        K += FeatureScalar(m_norm)*Ki;
+    }
+
+private:
+    K1 m_k1;
+    K2 m_k2;
+    int m_c1;
+    int m_c2;
+    double m_norm;
+};
+
 #endif
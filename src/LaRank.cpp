@@ -29,67 +29,206 @@
 
 #include "Config.h"
 #include "Features.h"
+#include "IntersectionTable.h"
 #include "Kernels.h"
 #include "Sample.h"
 #include "Rect.h"
 #include "GraphUtils/GraphUtils.h"
 
 #include <opencv/highgui.h>
+#include <algorithm>
 static const int kTileSize = 30;
 using namespace cv;
 
 using namespace std;
 using namespace Eigen;
 
-static const int kMaxSVs = 2000; // TODO (only used when no budget)
+// initial kernel cache size when there is no budget
+static const int kInitialCacheCapacity = 64;
 
+const int LaRank::kEvalBlockSize;
 
-LaRank::LaRank(const Config& conf, const Features& features, const Kernel& kernel) :
+// relative tolerance used to check the incremental gradient updates
+static const double kGradientTolerance = sizeof(FeatureScalar) < sizeof(double) ? 1e-4 : 1e-8;
+
+
+LaRank::LaRank(const Config& conf, const Features& features, const Kernel& kernel, std::mt19937& rng) :
     m_config(conf),
     m_features(features),
     m_kernel(kernel),
-    m_C(conf.svmC)
+    m_rng(rng),
+    m_patternsAllocated(0),
+    m_C(conf.svmC),
+    // with a budget the cache never needs more than budget+2 entries,
+    // otherwise it grows as needed up to svmCacheSize megabytes
+    m_K(conf.svmBudgetSize > 0 ? conf.svmBudgetSize+2 : kInitialCacheCapacity,
+        conf.svmBudgetSize > 0 ? 0 : (size_t)(conf.svmCacheSize*(1 << 20))),
+    m_primal(dynamic_cast<const LinearKernel*>(&kernel) != 0),
+    m_pIntersectionTable(0),
+    m_tableDirty(false),
+    m_cacheGradients(conf.svmBudgetSize > 0)
 {
-    int N = conf.svmBudgetSize > 0 ? conf.svmBudgetSize+2 : kMaxSVs;
-    m_K = MatrixXd::Zero(N, N);
+    int N = m_K.GetCapacity();
+    m_svX.resize(features.GetCount(), N);
+    m_svPatterns.reserve(N);
+    m_svLabels.reserve(N);
+    m_betas.reserve(N);
+    m_grads.reserve(N);
+    // every support pattern has at least one support vector
+    m_sps.reserve(N);
+    m_patternPool.reserve(N);
+    if (conf.svmBudgetSize > 0)
+    {
+        // the budget bounds the patterns as well, so they are all allocated
+        // up front. their sample storage is sized when first used
+        for (int i = 0; i < N; ++i)
+        {
+            SupportPattern* sp = new SupportPattern;
+            sp->svs.reserve(N);
+            m_patternPool.push_back(sp);
+        }
+        m_patternsAllocated = N;
+    }
+    if (m_primal)
+    {
+        m_w = VectorXd::Zero(features.GetCount());
+    }
+    if (dynamic_cast<const IntersectionKernel*>(&kernel))
+    {
+        m_pIntersectionTable = new IntersectionTable(features.GetCount());
+    }
     m_debugImage = Mat(800, 600, CV_8UC3);
 }
 
 LaRank::~LaRank()
 {
+    for (int i = 0; i < (int)m_sps.size(); ++i)
+    {
+        delete m_sps[i];
+    }
+    for (int i = 0; i < (int)m_patternPool.size(); ++i)
+    {
+        delete m_patternPool[i];
+    }
+    delete m_pIntersectionTable;
 }
 
-double LaRank::Evaluate(const Eigen::VectorXd& x, const FloatRect& y) const
+double LaRank::Evaluate(const Ref<const FeatureVector>& x, const FloatRect& y) const
 {
+    if (m_primal)
+    {
+        return m_w.dot(x.cast<double>());
+    }
+    if (m_pIntersectionTable)
+    {
+        assert(!m_tableDirty);
+        return m_pIntersectionTable->Eval(x);
+    }
+
     double f = 0.0;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    for (int i = 0; i < SupportVectorCount(); ++i)
     {
-        const SupportVector& sv = *m_svs[i];
-        f += sv.b*m_kernel.Eval(x, sv.x->x[sv.y]);
+        f += m_betas[i]*m_kernel.Eval(x, m_svX.col(i));
     }
     return f;
 }
 
-void LaRank::Eval(const MultiSample& sample, std::vector<double>& results)
+void LaRank::Eval(const MultiSample& sample, std::vector<double>& results) const
+{
+    results.resize(sample.GetRects().size());
+    Eval(sample, 0, (int)results.size(), results);
+}
+
+void LaRank::Eval(const MultiSample& sample, int start, int end, std::vector<double>& results) const
+{
+    FeatureMatrix X(min(kEvalBlockSize, end-start), m_features.GetCount());
+    for (int i = start; i < end; i += kEvalBlockSize)
+    {
+        int count = min(kEvalBlockSize, end-i);
+        m_features.Eval(sample, i, i+count, X.topRows(count));
+        EvalBlock(X.topRows(count), &results[i]);
+    }
+}
+
+void LaRank::Eval(const MultiSample& sample, const std::vector<FeatureMatrix>& shared, const std::vector<int>& rows, std::vector<double>& results) const
+{
+    const vector<FloatRect>& rects = sample.GetRects();
+    int n = (int)rects.size();
+    int d = m_features.GetCount();
+    results.resize(n);
+
+    FeatureMatrix X(min(kEvalBlockSize, n), d);
+    FeatureMatrix P;
+    vector<FloatRect> privateRects;
+    for (int i = 0; i < n; i += kEvalBlockSize)
+    {
+        int count = min(kEvalBlockSize, n-i);
+
+        privateRects.clear();
+        for (int j = 0; j < count; ++j)
+        {
+            if (rows[i+j] == -1) privateRects.push_back(rects[i+j]);
+        }
+        if ((int)privateRects.size() == count)
+        {
+            m_features.Eval(sample, i, i+count, X.topRows(count));
+            EvalBlock(X.topRows(count), &results[i]);
+            continue;
+        }
+
+        // compute the features nobody else needs, then gather them together
+        // with the shared ones, running down the columns as neighbouring
+        // samples tend to have neighbouring rows
+        int numPrivate = (int)privateRects.size();
+        if (numPrivate > 0)
+        {
+            P.resize(numPrivate, d);
+            m_features.Eval(MultiSample(sample.GetImage(), privateRects), 0, numPrivate, P);
+        }
+        for (int k = 0; k < d; ++k)
+        {
+            int p = 0;
+            for (int j = 0; j < count; ++j)
+            {
+                int r = rows[i+j];
+                X(j, k) = (r == -1) ? P(p++, k) : shared[r/kEvalBlockSize](r%kEvalBlockSize, k);
+            }
+        }
+        EvalBlock(X.topRows(count), &results[i]);
+    }
+}
+
+void LaRank::EvalBlock(const Ref<const FeatureMatrix>& X, double* results) const
 {
-    const FloatRect& centre(sample.GetRects()[0]);
-    vector<VectorXd> fvs;
-    const_cast<Features&>(m_features).Eval(sample, fvs);
-    results.resize(fvs.size());
-    for (int i = 0; i < (int)fvs.size(); ++i)
+    int count = (int)X.rows();
+    if (m_primal)
+    {
+        FeatureVector w = m_w.cast<FeatureScalar>();
+        VectorXd::Map(results, count) = (X*w).cast<double>();
+        return;
+    }
+    if (m_pIntersectionTable)
     {
-        // express y in coord frame of centre sample
-        FloatRect y(sample.GetRects()[i]);
-        y.Translate(-centre.XMin(), -centre.YMin());
-        results[i] = Evaluate(fvs[i], y);
+        assert(!m_tableDirty);
+        m_pIntersectionTable->Eval(X, results);
+        return;
     }
+
+    // the block is scored against all the support vectors with a single
+    // matrix-matrix product
+    int m = SupportVectorCount();
+    FeatureVector svB = VectorXd::Map(m_betas.data(), m).cast<FeatureScalar>();
+    FeatureMatrix K(count, m);
+    m_kernel.EvalBatch(X, m_svX.leftCols(m), K);
+    VectorXd::Map(results, count) = (K*svB).cast<double>();
 }
 
 void LaRank::Update(const MultiSample& sample, int y)
 {
     // add new support pattern
-    SupportPattern* sp = new SupportPattern;
     const vector<FloatRect>& rects = sample.GetRects();
+    int ns = (int)rects.size();
+    SupportPattern* sp = NewSupportPattern(ns);
     FloatRect centre = rects[y];
     for (int i = 0; i < (int)rects.size(); ++i)
     {
@@ -108,10 +247,24 @@ void LaRank::Update(const MultiSample& sample, int y)
         }
     }
     // evaluate features for each sample
-    sp->x.resize(rects.size());
-    const_cast<Features&>(m_features).Eval(sample, sp->x);
+    if (m_sampleX.rows() < ns)
+    {
+        m_sampleX.resize(ns, m_features.GetCount());
+        if (m_cacheGradients)
+        {
+            // the capacity is fixed by the budget, so this is only resized
+            // when the sample count grows
+            m_kernelScratch.resize(ns, max(ns, m_K.GetCapacity()));
+        }
+    }
+    m_features.Eval(sample, 0, ns, m_sampleX.topRows(ns));
+    sp->x.leftCols(ns) = m_sampleX.topRows(ns).transpose();
     sp->y = y;
-    sp->refCount = 0;
+    sp->ind = (int)m_sps.size();
+    if (m_cacheGradients)
+    {
+        InitPatternCache(sp, m_sampleX.topRows(ns));
+    }
     m_sps.push_back(sp);
 
     ProcessNew((int)m_sps.size()-1);
@@ -122,13 +275,95 @@ void LaRank::Update(const MultiSample& sample, int y)
         Reprocess();
         BudgetMaintenance();
     }
+
+    // leave the tables ready for Eval
+    UpdateTable();
+}
+
+void LaRank::UpdateTable()
+{
+    if (!m_pIntersectionTable || !m_tableDirty) return;
+
+    m_pIntersectionTable->Update(m_betas);
+    m_tableDirty = false;
+}
+
+LaRank::SupportPattern* LaRank::NewSupportPattern(int sampleCount)
+{
+    SupportPattern* sp;
+    if (m_patternPool.empty())
+    {
+        sp = new SupportPattern;
+        ++m_patternsAllocated;
+    }
+    else
+    {
+        sp = m_patternPool.back();
+        m_patternPool.pop_back();
+        sp->yv.clear();
+        sp->images.clear();
+        sp->svs.clear();
+    }
+
+    // storage only ever grows, so recycled patterns need no allocation
+    if (sp->x.cols() < sampleCount)
+    {
+        sp->yv.reserve(sampleCount);
+        sp->x.resize(m_features.GetCount(), sampleCount);
+        if (m_cacheGradients)
+        {
+            sp->g.resize(sampleCount);
+            sp->k.resize(sampleCount, m_K.GetCapacity());
+        }
+    }
+    return sp;
+}
+
+void LaRank::InitPatternCache(SupportPattern* sp, const Ref<const FeatureMatrix>& X)
+{
+    int n = SupportVectorCount();
+    int ns = (int)sp->yv.size();
+    Ref<FeatureMatrix> K = m_kernelScratch.topLeftCorner(ns, n);
+    m_kernel.EvalBatch(X, m_svX.leftCols(n), K);
+    sp->k.topLeftCorner(ns, n) = K;
+
+    for (int i = 0; i < ns; ++i)
+    {
+        sp->g[i] = -Loss(sp->yv[i], sp->yv[sp->y]);
+    }
+    sp->g.head(ns) -= K.cast<double>()*VectorXd::Map(m_betas.data(), n);
+}
+
+void LaRank::UpdatePatternGradients(int ind, double delta)
+{
+    // the discriminant function has changed by delta*k(x, x_ind)
+    for (int i = 0; i < (int)m_sps.size(); ++i)
+    {
+        SupportPattern* sp = m_sps[i];
+        int ns = (int)sp->yv.size();
+        sp->g.head(ns) -= delta*sp->k.col(ind).head(ns).cast<double>();
+    }
+}
+
+void LaRank::MakeRoom(int count)
+{
+    // once the kernel cache has reached its memory limit, remove support
+    // vectors as budget maintenance would
+    while (!m_K.Reserve(SupportVectorCount()+count))
+    {
+        BudgetMaintenanceRemove();
+    }
+    if (m_svX.cols() < m_K.GetCapacity())
+    {
+        m_svX.conservativeResize(NoChange, m_K.GetCapacity());
+    }
 }
 
 void LaRank::BudgetMaintenance()
 {
     if (m_config.svmBudgetSize > 0)
     {
-        while ((int)m_svs.size() > m_config.svmBudgetSize)
+        while (SupportVectorCount() > m_config.svmBudgetSize)
         {
             BudgetMaintenanceRemove();
         }
@@ -147,13 +382,14 @@ void LaRank::Reprocess()
 double LaRank::ComputeDual() const
 {
     double d = 0.0;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    int n = SupportVectorCount();
+    for (int i = 0; i < n; ++i)
     {
-        const SupportVector* sv = m_svs[i];
-        d -= sv->b*Loss(sv->x->yv[sv->y], sv->x->yv[sv->x->y]);
-        for (int j = 0; j < (int)m_svs.size(); ++j)
+        const SupportPattern* sp = m_svPatterns[i];
+        d -= m_betas[i]*Loss(sp->yv[m_svLabels[i]], sp->yv[sp->y]);
+        for (int j = 0; j < n; ++j)
         {
-            d -= 0.5*sv->b*m_svs[j]->b*m_K(i,j);
+            d -= 0.5*m_betas[i]*m_betas[j]*m_K(i,j);
         }
     }
     return d;
@@ -163,15 +399,13 @@ void LaRank::SMOStep(int ipos, int ineg)
 {
     if (ipos == ineg) return;
 
-    SupportVector* svp = m_svs[ipos];
-    SupportVector* svn = m_svs[ineg];
-    assert(svp->x == svn->x);
-    SupportPattern* sp = svp->x;
+    assert(m_svPatterns[ipos] == m_svPatterns[ineg]);
+    SupportPattern* sp = m_svPatterns[ipos];
 
 #if VERBOSE
-    cout << "SMO: gpos:" << svp->g << " gneg:" << svn->g << endl;
+    cout << "SMO: gpos:" << m_grads[ipos] << " gneg:" << m_grads[ineg] << endl;
 #endif
-    if ((svp->g - svn->g) < 1e-5)
+    if ((m_grads[ipos] - m_grads[ineg]) < 1e-5)
     {
 #if VERBOSE
         cout << "SMO: skipping" << endl;
@@ -180,37 +414,48 @@ void LaRank::SMOStep(int ipos, int ineg)
     else
     {
         double kii = m_K(ipos, ipos) + m_K(ineg, ineg) - 2*m_K(ipos, ineg);
-        double lu = (svp->g-svn->g)/kii;
+        double lu = (m_grads[ipos]-m_grads[ineg])/kii;
         // no need to clamp against 0 since we'd have skipped in that case
-        double l = min(lu, m_C*(int)(svp->y == sp->y) - svp->b);
+        double l = min(lu, m_C*(int)(m_svLabels[ipos] == sp->y) - m_betas[ipos]);
 
-        svp->b += l;
-        svn->b -= l;
+        m_betas[ipos] += l;
+        m_betas[ineg] -= l;
+
+        if (m_primal)
+        {
+            m_w += l*(m_svX.col(ipos) - m_svX.col(ineg)).cast<double>();
+        }
+        m_tableDirty = true;
 
         // update gradients
-        for (int i = 0; i < (int)m_svs.size(); ++i)
+        for (int i = 0; i < SupportVectorCount(); ++i)
+        {
+            m_grads[i] -= l*(m_K(i, ipos) - m_K(i, ineg));
+        }
+        if (m_cacheGradients)
         {
-            SupportVector* svi = m_svs[i];
-            svi->g -= l*(m_K(i, ipos) - m_K(i, ineg));
+            UpdatePatternGradients(ipos, l);
+            UpdatePatternGradients(ineg, -l);
         }
 #if VERBOSE
-        cout << "SMO: " << ipos << "," << ineg << " -- " << svp->b << "," << svn->b << " (" << l << ")" << endl;
+        cout << "SMO: " << ipos << "," << ineg << " -- " << m_betas[ipos] << "," << m_betas[ineg] << " (" << l << ")" << endl;
 #endif
     }
 
     // check if we should remove either sv now
 
-    if (fabs(svp->b) < 1e-8)
+    bool removeNeg = fabs(m_betas[ineg]) < 1e-8;
+    if (fabs(m_betas[ipos]) < 1e-8)
     {
         RemoveSupportVector(ipos);
-        if (ineg == (int)m_svs.size())
+        if (ineg == SupportVectorCount())
         {
-            // ineg and ipos will have been swapped during sv removal
+            // ineg will have been moved into ipos during sv removal
             ineg = ipos;
         }
     }
 
-    if (fabs(svn->b) < 1e-8)
+    if (removeNeg)
     {
         RemoveSupportVector(ineg);
     }
@@ -220,9 +465,23 @@ pair<int, double> LaRank::MinGradient(int ind)
 {
     const SupportPattern* sp = m_sps[ind];
     pair<int, double> minGrad(-1, DBL_MAX);
+    if (m_cacheGradients)
+    {
+        for (int i = 0; i < (int)sp->yv.size(); ++i)
+        {
+            if (sp->g[i] < minGrad.second)
+            {
+                minGrad.first = i;
+                minGrad.second = sp->g[i];
+            }
+        }
+        return minGrad;
+    }
+
+    UpdateTable();
     for (int i = 0; i < (int)sp->yv.size(); ++i)
     {
-        double grad = -Loss(sp->yv[i], sp->yv[sp->y]) - Evaluate(sp->x[i], sp->yv[i]);
+        double grad = -Loss(sp->yv[i], sp->yv[sp->y]) - Evaluate(sp->x.col(i), sp->yv[i]);
         if (grad < minGrad.second)
         {
             minGrad.first = i;
@@ -234,11 +493,26 @@ pair<int, double> LaRank::MinGradient(int ind)
 
 void LaRank::ProcessNew(int ind)
 {
+    // making room can remove a whole pattern, which moves the new pattern
+    // into its slot, so it is looked up first and its index taken after
+    SupportPattern* sp = m_sps[ind];
+    MakeRoom(2);
+
     // gradient is -f(x,y) since loss=0
-    int ip = AddSupportVector(m_sps[ind], m_sps[ind]->y, -Evaluate(m_sps[ind]->x[m_sps[ind]->y],m_sps[ind]->yv[m_sps[ind]->y]));
+    double g;
+    if (m_cacheGradients)
+    {
+        g = sp->g[sp->y];
+    }
+    else
+    {
+        UpdateTable();
+        g = -Evaluate(sp->x.col(sp->y), sp->yv[sp->y]);
+    }
+    int ip = AddSupportVector(sp, sp->y, g);
 
-    pair<int, double> minGrad = MinGradient(ind);
-    int in = AddSupportVector(m_sps[ind], minGrad.first, minGrad.second);
+    pair<int, double> minGrad = MinGradient(sp->ind);
+    int in = AddSupportVector(sp, minGrad.first, minGrad.second);
 
     SMOStep(ip, in);
 }
@@ -247,21 +521,22 @@ void LaRank::ProcessOld()
 {
     if (m_sps.size() == 0) return;
 
+    MakeRoom(1);
+
     // choose pattern to process
-    int ind = rand() % m_sps.size();
+    int ind = uniform_int_distribution<int>(0, (int)m_sps.size()-1)(m_rng);
 
     // find existing sv with largest grad and nonzero beta
+    const SupportPattern* sp = m_sps[ind];
     int ip = -1;
     double maxGrad = -DBL_MAX;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    for (int j = 0; j < (int)sp->svs.size(); ++j)
     {
-        if (m_svs[i]->x != m_sps[ind]) continue;
-
-        const SupportVector* svi = m_svs[i];
-        if (svi->g > maxGrad && svi->b < m_C*(int)(svi->y == m_sps[ind]->y))
+        int i = sp->svs[j];
+        if (m_grads[i] > maxGrad && m_betas[i] < m_C*(int)(m_svLabels[i] == sp->y))
         {
             ip = i;
-            maxGrad = svi->g;
+            maxGrad = m_grads[i];
         }
     }
     assert(ip != -1);
@@ -270,11 +545,10 @@ void LaRank::ProcessOld()
     // find potentially new sv with smallest grad
     pair<int, double> minGrad = MinGradient(ind);
     int in = -1;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    for (int j = 0; j < (int)sp->svs.size(); ++j)
     {
-        if (m_svs[i]->x != m_sps[ind]) continue;
-
-        if (m_svs[i]->y == minGrad.first)
+        int i = sp->svs[j];
+        if (m_svLabels[i] == minGrad.first)
         {
             in = i;
             break;
@@ -294,26 +568,25 @@ void LaRank::Optimize()
     if (m_sps.size() == 0) return;
 
     // choose pattern to optimize
-    int ind = rand() % m_sps.size();
+    int ind = uniform_int_distribution<int>(0, (int)m_sps.size()-1)(m_rng);
 
+    const SupportPattern* sp = m_sps[ind];
     int ip = -1;
     int in = -1;
     double maxGrad = -DBL_MAX;
     double minGrad = DBL_MAX;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    for (int j = 0; j < (int)sp->svs.size(); ++j)
     {
-        if (m_svs[i]->x != m_sps[ind]) continue;
-
-        const SupportVector* svi = m_svs[i];
-        if (svi->g > maxGrad && svi->b < m_C*(int)(svi->y == m_sps[ind]->y))
+        int i = sp->svs[j];
+        if (m_grads[i] > maxGrad && m_betas[i] < m_C*(int)(m_svLabels[i] == sp->y))
         {
             ip = i;
-            maxGrad = svi->g;
+            maxGrad = m_grads[i];
         }
-        if (svi->g < minGrad)
+        if (m_grads[i] < minGrad)
         {
             in = i;
-            minGrad = svi->g;
+            minGrad = m_grads[i];
         }
     }
     assert(ip != -1 && in != -1);
@@ -329,44 +602,84 @@ void LaRank::Optimize()
 
 int LaRank::AddSupportVector(SupportPattern* x, int y, double g)
 {
-    SupportVector* sv = new SupportVector;
-    sv->b = 0.0;
-    sv->x = x;
-    sv->y = y;
-    sv->g = g;
-
-    int ind = (int)m_svs.size();
-    m_svs.push_back(sv);
-    x->refCount++;
+    int ind = m_K.Add();
+    assert(ind == SupportVectorCount());
+    m_svPatterns.push_back(x);
+    m_svLabels.push_back(y);
+    m_betas.push_back(0.0);
+    m_grads.push_back(g);
+    m_svX.col(ind) = x->x.col(y);
+    x->svs.push_back(ind);
+
+    if (m_pIntersectionTable)
+    {
+        m_pIntersectionTable->Add(ind, m_svX.col(ind));
+        m_tableDirty = true;
+    }
 
 #if VERBOSE
     cout << "Adding SV: " << ind << endl;
 #endif
 
+    if (m_cacheGradients)
+    {
+        // extend the pattern caches, the gram matrix can then be read from them
+        for (int i = 0; i < (int)m_sps.size(); ++i)
+        {
+            SupportPattern* sp = m_sps[i];
+            int ns = (int)sp->yv.size();
+            Ref<FeatureMatrix> K = m_kernelScratch.topLeftCorner(1, ns);
+            m_kernel.EvalBatch(m_svX.col(ind).transpose(), sp->x.leftCols(ns), K);
+            sp->k.col(ind).head(ns) = K.row(0).transpose();
+        }
+        for (int i = 0; i <= ind; ++i)
+        {
+            m_K.Set(i, ind, m_svPatterns[i]->k(m_svLabels[i], ind));
+        }
+        return ind;
+    }
+
     // update kernel matrix
     for (int i = 0; i < ind; ++i)
     {
-        m_K(i,ind) = m_kernel.Eval(m_svs[i]->x->x[m_svs[i]->y], x->x[y]);
-        m_K(ind,i) = m_K(i,ind);
+        m_K.Set(i, ind, (FeatureScalar)m_kernel.Eval(m_svX.col(i), m_svX.col(ind)));
     }
-    m_K(ind,ind) = m_kernel.Eval(x->x[y]);
+    m_K.Set(ind, ind, (FeatureScalar)m_kernel.Eval(m_svX.col(ind)));
 
     return ind;
 }
 
-void LaRank::SwapSupportVectors(int ind1, int ind2)
+void LaRank::MoveSupportVector(int from, int to)
 {
-    SupportVector* tmp = m_svs[ind1];
-    m_svs[ind1] = m_svs[ind2];
-    m_svs[ind2] = tmp;
+    // overwrites the support vector at to, leaving the slot at from unused
+    vector<int>& svs = m_svPatterns[from]->svs;
+    *find(svs.begin(), svs.end(), from) = to;
+
+    m_svPatterns[to] = m_svPatterns[from];
+    m_svLabels[to] = m_svLabels[from];
+    m_betas[to] = m_betas[from];
+    m_grads[to] = m_grads[from];
+    m_svX.col(to) = m_svX.col(from);
 
-    VectorXd row1 = m_K.row(ind1);
-    m_K.row(ind1) = m_K.row(ind2);
-    m_K.row(ind2) = row1;
+    if (m_cacheGradients)
+    {
+        for (int i = 0; i < (int)m_sps.size(); ++i)
+        {
+            SupportPattern* sp = m_sps[i];
+            int ns = (int)sp->yv.size();
+            sp->k.col(to).head(ns) = sp->k.col(from).head(ns);
+        }
+    }
+}
 
-    VectorXd col1 = m_K.col(ind1);
-    m_K.col(ind1) = m_K.col(ind2);
-    m_K.col(ind2) = col1;
+void LaRank::RemoveSupportPattern(SupportPattern* sp)
+{
+    // fill the hole with the last support pattern
+    SupportPattern* last = m_sps.back();
+    m_sps[sp->ind] = last;
+    last->ind = sp->ind;
+    m_sps.pop_back();
+    m_patternPool.push_back(sp);
 }
 
 void LaRank::RemoveSupportVector(int ind)
@@ -375,30 +688,55 @@ void LaRank::RemoveSupportVector(int ind)
     cout << "Removing SV: " << ind << endl;
 #endif
 
-    m_svs[ind]->x->refCount--;
-    if (m_svs[ind]->x->refCount == 0)
+    if (m_primal)
     {
-        // also remove the support pattern
-        for (int i = 0; i < (int)m_sps.size(); ++i)
+        // removed svs should have (close to) zero beta, but make sure the
+        // weight vector stays consistent with the remaining svs
+        m_w -= m_betas[ind]*m_svX.col(ind).cast<double>();
+    }
+    // remove its contribution to the gradients
+    int last = SupportVectorCount()-1;
+    for (int i = 0; i <= last; ++i)
+    {
+        m_grads[i] += m_betas[ind]*m_K(i, ind);
+    }
+    if (m_cacheGradients)
+    {
+        UpdatePatternGradients(ind, -m_betas[ind]);
+    }
+
+    if (m_pIntersectionTable)
+    {
+        m_pIntersectionTable->Remove(ind, m_svX.col(ind));
+        if (ind < last)
         {
-            if (m_sps[i] == m_svs[ind]->x)
-            {
-                delete m_sps[i];
-                m_sps.erase(m_sps.begin()+i);
-                break;
-            }
+            // the last sv is about to be moved into this slot
+            m_pIntersectionTable->Move(last, ind, m_svX.col(last));
         }
+        m_tableDirty = true;
+    }
+
+    SupportPattern* sp = m_svPatterns[ind];
+    vector<int>::iterator it = find(sp->svs.begin(), sp->svs.end(), ind);
+    *it = sp->svs.back();
+    sp->svs.pop_back();
+    if (sp->svs.empty())
+    {
+        // also remove the support pattern
+        RemoveSupportPattern(sp);
     }
 
-    // make sure the support vector is at the back, this
-    // lets us keep the kernel matrix cached and valid
-    if (ind < (int)m_svs.size()-1)
+    // fill the hole with the last support vector, the kernel cache only
+    // needs to remap its index
+    m_K.Remove(ind);
+    if (ind < last)
     {
-        SwapSupportVectors(ind, (int)m_svs.size()-1);
-        ind = (int)m_svs.size()-1;
+        MoveSupportVector(last, ind);
     }
-    delete m_svs[ind];
-    m_svs.pop_back();
+    m_svPatterns.pop_back();
+    m_svLabels.pop_back();
+    m_betas.pop_back();
+    m_grads.pop_back();
 }
 
 void LaRank::BudgetMaintenanceRemove()
@@ -407,21 +745,23 @@ void LaRank::BudgetMaintenanceRemove()
     double minVal = DBL_MAX;
     int in = -1;
     int ip = -1;
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+    int n = SupportVectorCount();
+    for (int i = 0; i < n; ++i)
     {
-        if (m_svs[i]->b < 0.0)
+        if (m_betas[i] < 0.0)
         {
             // find corresponding positive sv
+            const vector<int>& svs = m_svPatterns[i]->svs;
             int j = -1;
-            for (int k = 0; k < (int)m_svs.size(); ++k)
+            for (int k = 0; k < (int)svs.size(); ++k)
             {
-                if (m_svs[k]->b > 0.0 && m_svs[k]->x == m_svs[i]->x)
+                if (m_betas[svs[k]] > 0.0)
                 {
-                    j = k;
+                    j = svs[k];
                     break;
                 }
             }
-            double val = m_svs[i]->b*m_svs[i]->b*(m_K(i,i) + m_K(j,j) - 2.0*m_K(i,j));
+            double val = m_betas[i]*m_betas[i]*(m_K(i,i) + m_K(j,j) - 2.0*m_K(i,j));
             if (val < minVal)
             {
                 minVal = val;
@@ -431,35 +771,78 @@ void LaRank::BudgetMaintenanceRemove()
         }
     }
 
-    // adjust weight of positive sv to compensate for removal of negative
-    m_svs[ip]->b += m_svs[in]->b;
+    // adjust weight of positive sv to compensate for removal of negative,
+    // the contribution of the negative sv to the gradients is removed along
+    // with it
+    m_betas[ip] += m_betas[in];
+    if (m_primal)
+    {
+        m_w += m_betas[in]*m_svX.col(ip).cast<double>();
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        m_grads[i] -= m_betas[in]*m_K(i, ip);
+    }
+    if (m_cacheGradients)
+    {
+        UpdatePatternGradients(ip, m_betas[in]);
+    }
+    m_tableDirty = true;
 
     // remove negative sv
     RemoveSupportVector(in);
-    if (ip == (int)m_svs.size())
+    if (ip == SupportVectorCount())
     {
-        // ip and in will have been swapped during support vector removal
+        // ip will have been moved into in during support vector removal
         ip = in;
     }
 
-    if (m_svs[ip]->b < 1e-8)
+    if (m_betas[ip] < 1e-8)
     {
         // also remove positive sv
         RemoveSupportVector(ip);
     }
 
-    // update gradients
-    // TODO: this could be made cheaper by just adjusting incrementally rather than recomputing
-    for (int i = 0; i < (int)m_svs.size(); ++i)
+#ifndef NDEBUG
+    double error;
+    assert(CheckGradients(error));
+#endif
+}
+
+bool LaRank::CheckGradients(double& error)
+{
+    // the incrementally updated gradients should match a full recompute
+    UpdateTable();
+    error = 0.0;
+    for (int i = 0; i < SupportVectorCount(); ++i)
     {
-        SupportVector& svi = *m_svs[i];
-        svi.g = -Loss(svi.x->yv[svi.y],svi.x->yv[svi.x->y]) - Evaluate(svi.x->x[svi.y], svi.x->yv[svi.y]);
+        const SupportPattern* sp = m_svPatterns[i];
+        int y = m_svLabels[i];
+        double g = -Loss(sp->yv[y], sp->yv[sp->y]) - Evaluate(m_svX.col(i), sp->yv[y]);
+        error = max(error, fabs(m_grads[i]-g)/(1.0+fabs(g)));
     }
+    // as should the sample gradients cached with each pattern, which are
+    // what MinGradient reads
+    if (m_cacheGradients)
+    {
+        for (int i = 0; i < (int)m_sps.size(); ++i)
+        {
+            const SupportPattern* sp = m_sps[i];
+            for (int k = 0; k < (int)sp->yv.size(); ++k)
+            {
+                double g = -Loss(sp->yv[k], sp->yv[sp->y]) - Evaluate(sp->x.col(k), sp->yv[k]);
+                error = max(error, fabs(sp->g[k]-g)/(1.0+fabs(g)));
+            }
+        }
+    }
+    return error < kGradientTolerance;
 }
 
 void LaRank::Debug()
 {
-    cout << m_sps.size() << "/" << m_svs.size() << " support patterns/vectors" << endl;
+    cout << m_sps.size() << "/" << SupportVectorCount() << " support patterns/vectors" << endl;
+    cout << GetPatternsInUse() << "/" << GetPatternsAllocated() << " pooled support patterns in use" << endl;
+    cout << GetSupportVectorsInUse() << "/" << GetSupportVectorCapacity() << " support vector slots in use" << endl;
     UpdateDebugImage();
     imshow("learner", m_debugImage);
 }
@@ -468,7 +851,7 @@ void LaRank::UpdateDebugImage()
 {
     m_debugImage.setTo(0);
 
-    int n = (int)m_svs.size();
+    int n = SupportVectorCount();
 
     if (n == 0) return;
 
@@ -486,25 +869,24 @@ void LaRank::UpdateDebugImage()
     int x = 0;
     int y = 0;
     int ind = 0;
-    float vals[kMaxSVs];
-    memset(vals, 0, sizeof(float)*n);
-    int drawOrder[kMaxSVs];
+    vector<float> vals(n, 0.f);
+    vector<int> drawOrder(n);
 
     for (int set = 0; set < 2; ++set)
     {
         for (int i = 0; i < n; ++i)
         {
-            if (((set == 0) ? 1 : -1)*m_svs[i]->b < 0.0) continue;
+            if (((set == 0) ? 1 : -1)*m_betas[i] < 0.0) continue;
 
             drawOrder[ind] = i;
-            vals[ind] = (float)m_svs[i]->b;
+            vals[ind] = (float)m_betas[i];
             ++ind;
 
             Mat I = m_debugImage(cv::Rect(x, y, tileSize, tileSize));
-            resize(m_svs[i]->x->images[m_svs[i]->y], temp, temp.size());
+            resize(m_svPatterns[i]->images[m_svLabels[i]], temp, temp.size());
             cvtColor(temp, I, CV_GRAY2RGB);
             double w = 1.0;
-            rectangle(I, Point(0, 0), Point(tileSize-1, tileSize-1), (m_svs[i]->b > 0.0) ? CV_RGB(0, (uchar)(255*w), 0) : CV_RGB((uchar)(255*w), 0, 0), 3);
+            rectangle(I, Point(0, 0), Point(tileSize-1, tileSize-1), (m_betas[i] > 0.0) ? CV_RGB(0, (uchar)(255*w), 0) : CV_RGB((uchar)(255*w), 0, 0), 3);
             x += tileSize;
             if ((x+tileSize) > kCanvasSize)
             {
@@ -517,8 +899,16 @@ void LaRank::UpdateDebugImage()
     const int kKernelPixelSize = 2;
     int kernelSize = kKernelPixelSize*n;
 
-    double kmin = m_K.minCoeff();
-    double kmax = m_K.maxCoeff();
+    double kmin = DBL_MAX;
+    double kmax = -DBL_MAX;
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            kmin = min(kmin, (double)m_K(i, j));
+            kmax = max(kmax, (double)m_K(i, j));
+        }
+    }
 
     if (kernelSize < m_debugImage.cols && kernelSize < m_debugImage.rows)
     {
@@ -543,5 +933,5 @@ void LaRank::UpdateDebugImage()
     I.setTo(Scalar(255,255,255));
     IplImage II = I;
     setGraphColor(0);
-    drawFloatGraph(vals, n, &II, 0.f, 0.f, I.cols, I.rows);
+    drawFloatGraph(&vals[0], n, &II, 0.f, 0.f, I.cols, I.rows);
 }
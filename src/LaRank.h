@@ -28,9 +28,12 @@
 #ifndef LARANK_H
 #define LARANK_H
 
+#include "FeatureTypes.h"
+#include "KernelCache.h"
 #include "Rect.h"
 #include "Sample.h"
 
+#include <random>
 #include <vector>
 #include <Eigen/Core>
 
@@ -38,50 +41,109 @@
 
 class Config;
 class Features;
+class IntersectionTable;
 class Kernel;
 
 class LaRank
 {
 public:
-    LaRank(const Config& conf, const Features& features, const Kernel& kernel);
+    // rng is used to choose the patterns to optimise, and must outlive the learner
+    LaRank(const Config& conf, const Features& features, const Kernel& kernel, std::mt19937& rng);
     ~LaRank();
 
-    virtual void Eval(const MultiSample& x, std::vector<double>& results);
+    // samples are scored in blocks of this size, see Eval
+    static const int kEvalBlockSize = 256;
+
+    virtual void Eval(const MultiSample& x, std::vector<double>& results) const;
+    // evaluate samples [start, end) into results[start, end), which must already
+    // be sized; when start is a multiple of kEvalBlockSize the scores are identical
+    // to those from a full evaluation, so ranges can be shared between threads
+    void Eval(const MultiSample& x, int start, int end, std::vector<double>& results) const;
+    // evaluate all the samples, reusing features computed elsewhere: the
+    // features of sample i are row rows[i] of shared, counting through its
+    // blocks of kEvalBlockSize rows in turn, or are computed here if rows[i] is -1
+    void Eval(const MultiSample& x, const std::vector<FeatureMatrix>& shared, const std::vector<int>& rows, std::vector<double>& results) const;
     virtual void Update(const MultiSample& x, int y);
 
+    // compare the incrementally updated gradients, of the support vectors and
+    // of the samples cached with each pattern, with a full recompute, setting
+    // error to the largest difference relative to 1+|g|. returns false if that
+    // is beyond the tolerance for the feature precision
+    bool CheckGradients(double& error);
+
     virtual void Debug();
 
+    // occupancy of the pools. support patterns are recycled through a free
+    // list, and support vectors live in arrays with room for the capacity
+    inline int GetPatternsInUse() const { return (int)m_sps.size(); }
+    inline int GetPatternsAllocated() const { return m_patternsAllocated; }
+    inline int GetSupportVectorsInUse() const { return SupportVectorCount(); }
+    inline int GetSupportVectorCapacity() const { return m_K.GetCapacity(); }
+
 private:
 
+    // support patterns are recycled through a pool, so their storage is sized
+    // for the largest sample count seen and only the first yv.size() samples
+    // are valid
     struct SupportPattern
     {
-        std::vector<Eigen::VectorXd> x;
+        // one feature vector per sample, stored as columns
+        FeatureMatrix x;
         std::vector<FloatRect> yv;
         std::vector<cv::Mat> images;
         int y;
-        int refCount;
-    };
-
-    struct SupportVector
-    {
-        SupportPattern* x;
-        int y;
-        double b;
-        double g;
-        cv::Mat image;
+        // position in m_sps, and the indices of its support vectors
+        int ind;
+        std::vector<int> svs;
+        // with gradient caching, the gradient -loss-f(x,y) of every sample and
+        // the kernel between every sample and every support vector
+        Eigen::VectorXd g;
+        FeatureMatrix k;
     };
 
     const Config& m_config;
     const Features& m_features;
     const Kernel& m_kernel;
+    std::mt19937& m_rng;
 
     std::vector<SupportPattern*> m_sps;
-    std::vector<SupportVector*> m_svs;
+    std::vector<SupportPattern*> m_patternPool;
+    int m_patternsAllocated;
+    // scratch space for the features of a new pattern, one sample per row
+    FeatureMatrix m_sampleX;
+    // scratch space for the kernel values of a new pattern or support
+    // vector, so that adding them allocates nothing once warmed up
+    FeatureMatrix m_kernelScratch;
+
+    // support vectors are kept as parallel arrays indexed by support vector,
+    // with the feature vector of support vector i in column i of m_svX, so
+    // that scans over them stream through contiguous memory
+    std::vector<SupportPattern*> m_svPatterns;
+    std::vector<int> m_svLabels;
+    std::vector<double> m_betas;
+    std::vector<double> m_grads;
+    FeatureMatrix m_svX;
 
     cv::Mat m_debugImage;
 
     double m_C;
-    Eigen::MatrixXd m_K;
+    KernelCache m_K;
+
+    // with a linear kernel the discriminant function is kept in its primal
+    // form w = sum_i b_i x_i, so that evaluating it is a single dot product.
+    // w is accumulated in double whatever the feature precision
+    bool m_primal;
+    Eigen::VectorXd m_w;
+
+    // with an intersection kernel the discriminant function is evaluated
+    // through per-dimension lookup tables, which are refreshed lazily
+    IntersectionTable* m_pIntersectionTable;
+    bool m_tableDirty;
+
+    // when the number of support vectors is bounded, every support pattern
+    // caches its sample gradients, which are updated incrementally as the
+    // betas change rather than recomputed on each MinGradient
+    bool m_cacheGradients;
 
     inline double Loss(const FloatRect& y1, const FloatRect& y2) const
     {
@@ -102,15 +164,24 @@ private:
     void ProcessOld();
     void Optimize();
 
+    inline int SupportVectorCount() const { return (int)m_betas.size(); }
     int AddSupportVector(SupportPattern* x, int y, double g);
     void RemoveSupportVector(int ind);
     void RemoveSupportVectors(int ind1, int ind2);
-    void SwapSupportVectors(int ind1, int ind2);
+    void MoveSupportVector(int from, int to);
+    void RemoveSupportPattern(SupportPattern* sp);
 
+    void MakeRoom(int count);
     void BudgetMaintenance();
     void BudgetMaintenanceRemove();
 
-    double Evaluate(const Eigen::VectorXd& x, const FloatRect& y) const;
+    double Evaluate(const Eigen::Ref<const FeatureVector>& x, const FloatRect& y) const;
+    // score one block of at most kEvalBlockSize feature vectors
+    void EvalBlock(const Eigen::Ref<const FeatureMatrix>& X, double* results) const;
+    void UpdateTable();
+    SupportPattern* NewSupportPattern(int sampleCount);
+    void InitPatternCache(SupportPattern* sp, const Eigen::Ref<const FeatureMatrix>& X);
+    void UpdatePatternGradients(int ind, double delta);
     void UpdateDebugImage();
 };
 
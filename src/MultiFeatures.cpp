@@ -41,13 +41,24 @@ MultiFeatures::MultiFeatures(const vector<Features*>& features) :
     SetCount(d);
 }
 
-void MultiFeatures::UpdateFeatureVector(const Sample& s)
+void MultiFeatures::Eval(const MultiSample& s, int start, int end, Ref<FeatureMatrix> featVecs) const
+{
+    int col = 0;
+    for (int i = 0; i < (int)m_features.size(); ++i)
+    {
+        int n = m_features[i]->GetCount();
+        m_features[i]->Eval(s, start, end, featVecs.middleCols(col, n));
+        col += n;
+    }
+}
+
+void MultiFeatures::UpdateFeatureVector(const Sample& s, Ref<FeatureVector> featVec) const
 {
     int start = 0;
     for (int i = 0; i < (int)m_features.size(); ++i)
     {
         int n =  m_features[i]->GetCount();
-        m_featVec.segment(start, n) = m_features[i]->Eval(s);
+        m_features[i]->Eval(s, featVec.segment(start, n));
         start += n;
     }
 }
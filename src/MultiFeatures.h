@@ -39,10 +39,49 @@ class MultiFeatures : public Features
 public:
     MultiFeatures(const std::vector<Features*>& features);
 
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const;
+
 private:
     std::vector<Features*> m_features;
 
-    virtual void UpdateFeatureVector(const Sample& s);
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const;
+};
+
+// two feature types concatenated, as MultiFeatures does, but with the types
+// known at compile time so the calls into each can be inlined. used for the
+// combinations we deploy, with MultiFeatures covering any other.
+template <class F1, class F2>
+class PairFeatures : public Features
+{
+public:
+    PairFeatures(const F1& f1, const F2& f2) :
+        m_f1(f1),
+        m_f2(f2),
+        m_n1(f1.GetCount()),
+        m_n2(f2.GetCount())
+    {
+        SetCount(m_n1+m_n2);
+    }
+
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const
+    {
+        m_f1.F1::Eval(s, start, end, featVecs.leftCols(m_n1));
+        m_f2.F2::Eval(s, start, end, featVecs.rightCols(m_n2));
+    }
+
+private:
+    const F1& m_f1;
+    const F2& m_f2;
+    int m_n1;
+    int m_n2;
+
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const
+    {
+        m_f1.Eval(s, featVec.head(m_n1));
+        m_f2.Eval(s, featVec.tail(m_n2));
+    }
 };
 
 #endif
@@ -0,0 +1,240 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MultiTracker.h"
+#include "Features.h"
+#include "ImageRep.h"
+#include "LaRank.h"
+#include "Sample.h"
+#include "ThreadPool.h"
+#include "Tracker.h"
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+MultiTracker::MultiTracker(const Config& conf) :
+    m_trackerConfig(conf),
+    m_pImage(0),
+    m_pThreadPool(0)
+{
+    int numThreads = conf.numThreads;
+    if (numThreads <= 0)
+    {
+        numThreads = max((int)thread::hardware_concurrency(), 1);
+    }
+    m_pThreadPool = new ThreadPool(numThreads);
+
+    m_trackerConfig.numThreads = 1;
+}
+
+MultiTracker::~MultiTracker()
+{
+    for (int i = 0; i < (int)m_trackers.size(); ++i)
+    {
+        delete m_trackers[i];
+    }
+    delete m_pImage;
+    delete m_pThreadPool;
+}
+
+int MultiTracker::AddTargets(const cv::Mat& frame, const vector<FloatRect>& bbs)
+{
+    int first = (int)m_trackers.size();
+    for (int i = 0; i < (int)bbs.size(); ++i)
+    {
+        m_trackers.push_back(new Tracker(m_trackerConfig));
+    }
+    if (bbs.empty()) return first;
+
+    if (!m_pImage)
+    {
+        const Tracker& t = *m_trackers[first];
+        m_pImage = new ImageRep(t.NeedsIntegralImage(), t.NeedsIntegralHist());
+    }
+    m_pImage->Update(frame);
+    m_pThreadPool->Run((int)bbs.size(), [&](int i)
+    {
+        m_trackers[first+i]->Initialise(*m_pImage, bbs[i]);
+    });
+    return first;
+}
+
+int MultiTracker::AddTarget(const cv::Mat& frame, const FloatRect& bb)
+{
+    return AddTargets(frame, vector<FloatRect>(1, bb));
+}
+
+void MultiTracker::RemoveTarget(int ind)
+{
+    assert(ind >= 0 && ind < (int)m_trackers.size());
+    delete m_trackers[ind];
+    m_trackers.erase(m_trackers.begin()+ind);
+}
+
+const FloatRect& MultiTracker::GetBB(int ind) const
+{
+    return m_trackers[ind]->GetBB();
+}
+
+void MultiTracker::Track(const cv::Mat& frame)
+{
+    int numTargets = (int)m_trackers.size();
+    if (numTargets == 0) return;
+
+    // every target shares the same configuration, so the same image
+    // representation and the same features. the image is only prepared
+    // over the regions the targets will read
+    const Tracker& first = *m_trackers[0];
+    IntRect region = first.GetTrackRegion();
+    for (int t = 1; t < numTargets; ++t)
+    {
+        IntRect r = m_trackers[t]->GetTrackRegion();
+        int x0 = min(region.XMin(), r.XMin());
+        int y0 = min(region.YMin(), r.YMin());
+        region.Set(x0, y0, max(region.XMax(), r.XMax())-x0, max(region.YMax(), r.YMax())-y0);
+    }
+    m_pImage->Update(frame, region);
+    const ImageRep& image = *m_pImage;
+    const Features& features = first.GetFeatures();
+
+    vector<vector<FloatRect> > rects(numTargets);
+    for (int t = 0; t < numTargets; ++t)
+    {
+        m_trackers[t]->GetCandidates(image, rects[t]);
+    }
+
+    // candidate windows lie on the pixel grid, so targets of the same size
+    // with overlapping search regions share windows. the features of each
+    // window searched by more than one target are computed once up front,
+    // the rest are left to the target that needs them
+    struct Group
+    {
+        std::vector<FloatRect> rects;
+        std::vector<FeatureMatrix> blocks;
+    };
+    vector<Group> groups;
+    vector<int> targetGroups(numTargets, -1);
+    vector<vector<int> > rows(numTargets);
+    vector<int> counts;
+    vector<int> grid;
+    for (int t = 0; t < numTargets; ++t)
+    {
+        if (targetGroups[t] != -1) continue;
+        IntRect bb(m_trackers[t]->GetBB());
+        int g = (int)groups.size();
+        groups.push_back(Group());
+
+        vector<int> members;
+        int xMin = INT_MAX, yMin = INT_MAX, xMax = INT_MIN, yMax = INT_MIN;
+        for (int u = t; u < numTargets; ++u)
+        {
+            IntRect other(m_trackers[u]->GetBB());
+            if (targetGroups[u] != -1 || other.Width() != bb.Width() || other.Height() != bb.Height()) continue;
+            targetGroups[u] = g;
+            members.push_back(u);
+            rows[u].assign(rects[u].size(), -1);
+            for (int i = 0; i < (int)rects[u].size(); ++i)
+            {
+                IntRect r(rects[u][i]);
+                xMin = min(xMin, r.XMin());
+                yMin = min(yMin, r.YMin());
+                xMax = max(xMax, r.XMin());
+                yMax = max(yMax, r.YMin());
+            }
+        }
+        if (members.size() < 2 || xMin > xMax) continue;
+
+        int gridWidth = xMax-xMin+1;
+        counts.assign(gridWidth*(yMax-yMin+1), 0);
+        grid.assign(counts.size(), -1);
+        for (int m = 0; m < (int)members.size(); ++m)
+        {
+            const vector<FloatRect>& memberRects = rects[members[m]];
+            for (int i = 0; i < (int)memberRects.size(); ++i)
+            {
+                IntRect r(memberRects[i]);
+                ++counts[(r.YMin()-yMin)*gridWidth+(r.XMin()-xMin)];
+            }
+        }
+        for (int m = 0; m < (int)members.size(); ++m)
+        {
+            int u = members[m];
+            for (int i = 0; i < (int)rects[u].size(); ++i)
+            {
+                IntRect r(rects[u][i]);
+                int cell = (r.YMin()-yMin)*gridWidth+(r.XMin()-xMin);
+                if (counts[cell] < 2) continue;
+                if (grid[cell] == -1)
+                {
+                    grid[cell] = (int)groups[g].rects.size();
+                    groups[g].rects.push_back(rects[u][i]);
+                }
+                rows[u][i] = grid[cell];
+            }
+        }
+    }
+
+    // compute the shared features across the pool, one evaluation block
+    // per task
+    int d = features.GetCount();
+    vector<pair<int, int> > blocks;
+    for (int g = 0; g < (int)groups.size(); ++g)
+    {
+        int n = (int)groups[g].rects.size();
+        int numBlocks = (n+LaRank::kEvalBlockSize-1)/LaRank::kEvalBlockSize;
+        groups[g].blocks.resize(numBlocks);
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            blocks.push_back(make_pair(g, b));
+        }
+    }
+    m_pThreadPool->Run((int)blocks.size(), [&](int i)
+    {
+        Group& group = groups[blocks[i].first];
+        int start = blocks[i].second*LaRank::kEvalBlockSize;
+        int count = min(LaRank::kEvalBlockSize, (int)group.rects.size()-start);
+        MultiSample sample(image, group.rects);
+        FeatureMatrix& X = group.blocks[blocks[i].second];
+        X.resize(count, d);
+        features.Eval(sample, start, start+count, X);
+    });
+
+    // then score and update each target on its own thread
+    m_pThreadPool->Run(numTargets, [&](int t)
+    {
+        m_trackers[t]->Track(image, rects[t], groups[targetGroups[t]].blocks, rows[t]);
+    });
+}
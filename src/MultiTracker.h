@@ -0,0 +1,70 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MULTI_TRACKER_H
+#define MULTI_TRACKER_H
+
+#include "Config.h"
+#include "Rect.h"
+
+#include <vector>
+#include <opencv/cv.h>
+
+class ImageRep;
+class ThreadPool;
+class Tracker;
+
+// tracks several targets through the same sequence. each frame is turned
+// into a single ImageRep shared by every target, the targets are stepped
+// concurrently on a thread pool, and the features of candidate windows
+// searched by more than one target are only computed once
+class MultiTracker
+{
+public:
+    MultiTracker(const Config& conf);
+    ~MultiTracker();
+
+    // start tracking new targets in frame, returns the index of the first
+    int AddTargets(const cv::Mat& frame, const std::vector<FloatRect>& bbs);
+    int AddTarget(const cv::Mat& frame, const FloatRect& bb);
+    void RemoveTarget(int ind);
+    void Track(const cv::Mat& frame);
+
+    inline int GetTargetCount() const { return (int)m_trackers.size(); }
+    const FloatRect& GetBB(int ind) const;
+
+private:
+    // each target tracks on a single thread, the pool here spreads the
+    // targets over the threads instead
+    Config m_trackerConfig;
+    std::vector<Tracker*> m_trackers;
+    // shared by all the targets, and rebuilt in place for each frame
+    ImageRep* m_pImage;
+    ThreadPool* m_pThreadPool;
+};
+
+#endif
@@ -30,33 +30,93 @@
 #include "Sample.h"
 #include "Rect.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cassert>
 
 using namespace Eigen;
 using namespace cv;
+using namespace std;
 
 static const int kPatchSize = 16;
 
-RawFeatures::RawFeatures(const Config& conf) :
-    m_patchImage(kPatchSize, kPatchSize, CV_8UC1)
+RawFeatures::RawFeatures(const Config& conf)
 {
     SetCount(kPatchSize*kPatchSize);
 }
 
-void RawFeatures::UpdateFeatureVector(const Sample& s)
+// the patch pixels average cells of the window, cell i covering
+// [starts[i], ends[i]). every cell holds at least one pixel, so windows
+// narrower than the patch repeat pixels
+static void CellBounds(int size, int* starts, int* ends)
+{
+    for (int i = 0; i < kPatchSize; ++i)
+    {
+        starts[i] = i*size/kPatchSize;
+        ends[i] = max(starts[i]+1, (i+1)*size/kPatchSize);
+    }
+}
+
+void RawFeatures::UpdateFeatureVector(const Sample& s, Ref<FeatureVector> featVec) const
 {
     IntRect rect = s.GetROI(); // note this truncates to integers
-    cv::Rect roi(rect.XMin(), rect.YMin(), rect.Width(), rect.Height());
-    cv::resize(s.GetImage().GetImage(0)(roi), m_patchImage, m_patchImage.size());
-    //equalizeHist(m_patchImage, m_patchImage);
+    int xStarts[kPatchSize], xEnds[kPatchSize], yStarts[kPatchSize], yEnds[kPatchSize];
+    CellBounds(rect.Width(), xStarts, xEnds);
+    CellBounds(rect.Height(), yStarts, yEnds);
 
     int ind = 0;
     for (int i = 0; i < kPatchSize; ++i)
     {
-        uchar* pixel = m_patchImage.ptr(i);
-        for (int j = 0; j < kPatchSize; ++j, ++pixel, ++ind)
+        for (int j = 0; j < kPatchSize; ++j, ++ind)
+        {
+            IntRect cell(rect.XMin()+xStarts[j], rect.YMin()+yStarts[i], xEnds[j]-xStarts[j], yEnds[i]-yStarts[i]);
+            featVec[ind] = (FeatureScalar)(s.GetImage().Sum(cell)*(1.0/(255*cell.Area())));
+        }
+    }
+}
+
+void RawFeatures::Eval(const MultiSample& s, int start, int end, Ref<FeatureMatrix> featVecs) const
+{
+    const vector<FloatRect>& rects = s.GetRects();
+    const Mat& integral = s.GetImage().GetIntegralImage();
+    const IntRect& imageRect = s.GetImage().GetRect();
+    int step = (int)integral.step1();
+
+    // the corners of every cell, as offsets into the integral image from the
+    // window's origin, are worked out once per window size
+    int width = -1, height = -1;
+    vector<int> offsets(4*m_featureCount);
+    vector<double> scales(m_featureCount);
+    for (int k = start; k < end; ++k)
+    {
+        IntRect rect = rects[k];
+        if (rect.Width() != width || rect.Height() != height)
+        {
+            width = rect.Width();
+            height = rect.Height();
+            int xStarts[kPatchSize], xEnds[kPatchSize], yStarts[kPatchSize], yEnds[kPatchSize];
+            CellBounds(width, xStarts, xEnds);
+            CellBounds(height, yStarts, yEnds);
+            int ind = 0;
+            for (int i = 0; i < kPatchSize; ++i)
+            {
+                for (int j = 0; j < kPatchSize; ++j, ++ind)
+                {
+                    offsets[4*ind] = yStarts[i]*step+xStarts[j];
+                    offsets[4*ind+1] = yEnds[i]*step+xEnds[j];
+                    offsets[4*ind+2] = yStarts[i]*step+xEnds[j];
+                    offsets[4*ind+3] = yEnds[i]*step+xStarts[j];
+                    scales[ind] = 1.0/(255*(xEnds[j]-xStarts[j])*(yEnds[i]-yStarts[i]));
+                }
+            }
+        }
+
+        assert(rect.IsInside(imageRect));
+        const int* origin = integral.ptr<int>(rect.YMin()-imageRect.YMin()) + rect.XMin()-imageRect.XMin();
+        const int* o = &offsets[0];
+        for (int ind = 0; ind < m_featureCount; ++ind, o += 4)
         {
-            m_featVec[ind] = ((double)*pixel)/255;
+            int sum = origin[o[0]]+origin[o[1]]-origin[o[2]]-origin[o[3]];
+            featVecs(k-start, ind) = (FeatureScalar)(sum*scales[ind]);
         }
     }
 }
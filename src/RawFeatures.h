@@ -34,15 +34,18 @@
 
 class Config;
 
-class RawFeatures : public Features
+// the window resampled to a small patch, each patch pixel averaging a cell
+// of the window through the integral image
+class RawFeatures final : public Features
 {
 public:
     RawFeatures(const Config& conf);
 
-private:
-    cv::Mat m_patchImage;
+    using Features::Eval;
+    virtual void Eval(const MultiSample& s, int start, int end, Eigen::Ref<FeatureMatrix> featVecs) const;
 
-    virtual void UpdateFeatureVector(const Sample& s);
+private:
+    virtual void UpdateFeatureVector(const Sample& s, Eigen::Ref<FeatureVector> featVec) const;
 };
 
 #endif
@@ -0,0 +1,117 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int numThreads) :
+    m_pTask(0),
+    m_count(0),
+    m_next(0),
+    m_pending(0),
+    m_generation(0),
+    m_stop(false)
+{
+    for (int i = 1; i < numThreads; ++i)
+    {
+        m_threads.push_back(thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_startCondition.notify_all();
+    for (int i = 0; i < (int)m_threads.size(); ++i)
+    {
+        m_threads[i].join();
+    }
+}
+
+void ThreadPool::Run(int count, const function<void(int)>& task)
+{
+    if (m_threads.empty())
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+    m_pTask = &task;
+    m_count = count;
+    m_next = 0;
+    m_pending = count;
+    ++m_generation;
+    m_startCondition.notify_all();
+
+    // the calling thread works too
+    RunTasks(lock);
+    while (m_pending > 0)
+    {
+        m_doneCondition.wait(lock);
+    }
+    m_pTask = 0;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    unsigned int generation = 0;
+    unique_lock<mutex> lock(m_mutex);
+    while (true)
+    {
+        while (!m_stop && m_generation == generation)
+        {
+            m_startCondition.wait(lock);
+        }
+        if (m_stop) return;
+
+        generation = m_generation;
+        RunTasks(lock);
+    }
+}
+
+void ThreadPool::RunTasks(unique_lock<mutex>& lock)
+{
+    while (m_next < m_count)
+    {
+        int i = m_next++;
+        lock.unlock();
+        (*m_pTask)(i);
+        lock.lock();
+        if (--m_pending == 0)
+        {
+            m_doneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * Struck: Structured Output Tracking with Kernels
+ *
+ * Code to accompany the paper:
+ *   Struck: Structured Output Tracking with Kernels
+ *   Sam Hare, Amir Saffari, Philip H. S. Torr
+ *   International Conference on Computer Vision (ICCV), 2011
+ *
+ * Copyright (C) 2011 Sam Hare, Oxford Brookes University, Oxford, UK
+ *
+ * This file is part of Struck.
+ *
+ * Struck is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Struck is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Struck.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // numThreads includes the calling thread, so a pool of one thread
+    // simply runs every task inline
+    ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    inline int GetThreadCount() const { return (int)m_threads.size()+1; }
+
+    // run task(i) for every i in [0, count) and wait for them all to finish.
+    // tasks may run in any order and on any thread, Run itself must not be
+    // called concurrently on the same pool
+    void Run(int count, const std::function<void(int)>& task);
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+
+    const std::function<void(int)>* m_pTask;
+    int m_count;
+    int m_next;
+    int m_pending;
+    unsigned int m_generation;
+    bool m_stop;
+
+    void WorkerLoop();
+    void RunTasks(std::unique_lock<std::mutex>& lock);
+};
+
+#endif
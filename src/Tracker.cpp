@@ -30,12 +30,14 @@
 #include "ImageRep.h"
 #include "Sampler.h"
 #include "Sample.h"
+#include "ThreadPool.h"
 #include "GraphUtils/GraphUtils.h"
 
 #include "HaarFeatures.h"
 #include "RawFeatures.h"
 #include "HistogramFeatures.h"
 #include "MultiFeatures.h"
+#include "FourierFeatures.h"
 
 #include "Kernels.h"
 
@@ -48,6 +50,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <thread>
 
 using namespace cv;
 using namespace std;
@@ -57,15 +60,27 @@ Tracker::Tracker(const Config& conf) :
     m_config(conf),
     m_initialised(false),
     m_pLearner(0),
+    m_pImage(0),
+    m_pThreadPool(0),
+    m_rng(conf.seed),
     m_debugImage(2*conf.searchRadius+1, 2*conf.searchRadius+1, CV_32FC1),
     m_needsIntegralImage(false)
 {
+    int numThreads = conf.numThreads;
+    if (numThreads <= 0)
+    {
+        numThreads = max((int)thread::hardware_concurrency(), 1);
+    }
+    m_pThreadPool = new ThreadPool(numThreads);
+
     Reset();
 }
 
 Tracker::~Tracker()
 {
     delete m_pLearner;
+    delete m_pImage;
+    delete m_pThreadPool;
     for (int i = 0; i < (int)m_features.size(); ++i)
     {
         delete m_features[i];
@@ -73,6 +88,79 @@ Tracker::~Tracker()
     }
 }
 
+// the feature combinations we deploy are composed statically, so their
+// evaluation can be inlined end to end; any other goes through MultiFeatures
+template <class F1, class F2>
+static Features* ComposeFeatures(const Features* f1, const Features* f2)
+{
+    const F1* a = dynamic_cast<const F1*>(f1);
+    const F2* b = dynamic_cast<const F2*>(f2);
+    if (a && b) return new PairFeatures<F1, F2>(*a, *b);
+    return 0;
+}
+
+static Features* ComposeFeatures(const vector<Features*>& features)
+{
+    Features* f = 0;
+    if (features.size() == 2)
+    {
+        if (!f) f = ComposeFeatures<HaarFeatures, HistogramFeatures>(features[0], features[1]);
+        if (!f) f = ComposeFeatures<HistogramFeatures, HaarFeatures>(features[0], features[1]);
+        if (!f) f = ComposeFeatures<RawFeatures, HaarFeatures>(features[0], features[1]);
+        if (!f) f = ComposeFeatures<HaarFeatures, RawFeatures>(features[0], features[1]);
+    }
+    return f ? f : new MultiFeatures(features);
+}
+
+template <class K1>
+static Kernel* ComposeKernel(const K1& k1, const Kernel* k2, const vector<int>& counts)
+{
+    if (const LinearKernel* k = dynamic_cast<const LinearKernel*>(k2))
+    {
+        return new PairKernel<K1, LinearKernel>(k1, *k, counts[0], counts[1]);
+    }
+    if (const GaussianKernel* k = dynamic_cast<const GaussianKernel*>(k2))
+    {
+        return new PairKernel<K1, GaussianKernel>(k1, *k, counts[0], counts[1]);
+    }
+    if (const IntersectionKernel* k = dynamic_cast<const IntersectionKernel*>(k2))
+    {
+        return new PairKernel<K1, IntersectionKernel>(k1, *k, counts[0], counts[1]);
+    }
+    if (const Chi2Kernel* k = dynamic_cast<const Chi2Kernel*>(k2))
+    {
+        return new PairKernel<K1, Chi2Kernel>(k1, *k, counts[0], counts[1]);
+    }
+    return 0;
+}
+
+// likewise any pair of kernels, which covers those the deployed features
+// are used with
+static Kernel* ComposeKernel(const vector<Kernel*>& kernels, const vector<int>& counts)
+{
+    Kernel* k = 0;
+    if (kernels.size() == 2)
+    {
+        if (const LinearKernel* k1 = dynamic_cast<const LinearKernel*>(kernels[0]))
+        {
+            k = ComposeKernel(*k1, kernels[1], counts);
+        }
+        else if (const GaussianKernel* k1 = dynamic_cast<const GaussianKernel*>(kernels[0]))
+        {
+            k = ComposeKernel(*k1, kernels[1], counts);
+        }
+        else if (const IntersectionKernel* k1 = dynamic_cast<const IntersectionKernel*>(kernels[0]))
+        {
+            k = ComposeKernel(*k1, kernels[1], counts);
+        }
+        else if (const Chi2Kernel* k1 = dynamic_cast<const Chi2Kernel*>(kernels[0]))
+        {
+            k = ComposeKernel(*k1, kernels[1], counts);
+        }
+    }
+    return k ? k : new MultiKernel(kernels, counts);
+}
+
 void Tracker::Reset()
 {
     m_initialised = false;
@@ -101,13 +189,13 @@ void Tracker::Reset()
             break;
         case Config::kFeatureTypeRaw:
             m_features.push_back(new RawFeatures(m_config));
+            m_needsIntegralImage = true;
             break;
         case Config::kFeatureTypeHistogram:
             m_features.push_back(new HistogramFeatures(m_config));
             m_needsIntegralHist = true;
             break;
         }
-        featureCounts.push_back(m_features.back()->GetCount());
 
         switch (m_config.features[i].kernel)
         {
@@ -115,7 +203,17 @@ void Tracker::Reset()
             m_kernels.push_back(new LinearKernel());
             break;
         case Config::kKernelTypeGaussian:
-            m_kernels.push_back(new GaussianKernel(m_config.features[i].params[0]));
+            if (m_config.fourierFeatureCount > 0)
+            {
+                // approximate the gaussian with a linear kernel on random fourier features
+                m_features.back() = new FourierFeatures(m_features.back(), m_config.features[i].params[0],
+                    m_config.fourierFeatureCount, m_config.seed+i);
+                m_kernels.push_back(new LinearKernel());
+            }
+            else
+            {
+                m_kernels.push_back(new GaussianKernel(m_config.features[i].params[0]));
+            }
             break;
         case Config::kKernelTypeIntersection:
             m_kernels.push_back(new IntersectionKernel());
@@ -124,25 +222,40 @@ void Tracker::Reset()
             m_kernels.push_back(new Chi2Kernel());
             break;
         }
+        featureCounts.push_back(m_features.back()->GetCount());
     }
 
     if (numFeatures > 1)
     {
-        MultiFeatures* f = new MultiFeatures(m_features);
-        m_features.push_back(f);
-
-        MultiKernel* k = new MultiKernel(m_kernels, featureCounts);
-        m_kernels.push_back(k);
+        m_features.push_back(ComposeFeatures(m_features));
+        m_kernels.push_back(ComposeKernel(m_kernels, featureCounts));
     }
 
-    m_pLearner = new LaRank(m_config, *m_features.back(), *m_kernels.back());
+    m_pLearner = new LaRank(m_config, *m_features.back(), *m_kernels.back(), m_rng);
+
+    if (m_pImage) delete m_pImage;
+    m_pImage = new ImageRep(m_needsIntegralImage, m_needsIntegralHist);
 }
 
 
+// the samples for the learner lie within 2*searchRadius of the box, and
+// those for tracking within searchRadius, so only the box grown by these
+// (plus a pixel for rounding) is needed from each frame
+static IntRect GrowRect(const FloatRect& r, int margin)
+{
+    IntRect ir(r);
+    return IntRect(ir.XMin()-margin, ir.YMin()-margin, ir.Width()+2*margin, ir.Height()+2*margin);
+}
+
 void Tracker::Initialise(const cv::Mat& frame, FloatRect bb)
+{
+    m_pImage->Update(frame, GrowRect(bb, 2*m_config.searchRadius+1));
+    Initialise(*m_pImage, bb);
+}
+
+void Tracker::Initialise(const ImageRep& image, FloatRect bb)
 {
     m_bb = IntRect(bb);
-    ImageRep image(frame, m_needsIntegralImage, m_needsIntegralHist);
     for (int i = 0; i < 1; ++i)
     {
         UpdateLearner(image);
@@ -150,30 +263,91 @@ void Tracker::Initialise(const cv::Mat& frame, FloatRect bb)
     m_initialised = true;
 }
 
+void Tracker::GetCandidates(const ImageRep& image, vector<FloatRect>& rects) const
+{
+    vector<FloatRect> allRects = Sampler::PixelSamples(m_bb, m_config.searchRadius);
+
+    rects.clear();
+    rects.reserve(allRects.size());
+    for (int i = 0; i < (int)allRects.size(); ++i)
+    {
+        if (!allRects[i].IsInside(image.GetRect())) continue;
+        rects.push_back(allRects[i]);
+    }
+}
+
+IntRect Tracker::GetTrackRegion() const
+{
+    return GrowRect(m_bb, 3*m_config.searchRadius+1);
+}
+
 void Tracker::Track(const cv::Mat& frame)
+{
+    m_pImage->Update(frame, GetTrackRegion());
+    Track(*m_pImage);
+}
+
+void Tracker::Track(const ImageRep& image)
 {
     assert(m_initialised);
 
-    ImageRep image(frame, m_needsIntegralImage, m_needsIntegralHist);
+    vector<FloatRect> keptRects;
+    GetCandidates(image, keptRects);
 
-    vector<FloatRect> rects = Sampler::PixelSamples(m_bb, m_config.searchRadius);
+    MultiSample sample(image, keptRects);
 
-    vector<FloatRect> keptRects;
-    keptRects.reserve(rects.size());
-    for (int i = 0; i < (int)rects.size(); ++i)
+    // split the samples into contiguous chunks of whole evaluation blocks,
+    // one per thread, and find the best sample in each chunk
+    int n = (int)keptRects.size();
+    int numBlocks = (n+LaRank::kEvalBlockSize-1)/LaRank::kEvalBlockSize;
+    int numChunks = min(m_pThreadPool->GetThreadCount(), numBlocks);
+    vector<double> scores(n);
+    vector<int> chunkBestInds(numChunks, -1);
+    m_pThreadPool->Run(numChunks, [&](int chunk)
     {
-        if (!rects[i].IsInside(image.GetRect())) continue;
-        keptRects.push_back(rects[i]);
+        int start = min(chunk*numBlocks/numChunks*LaRank::kEvalBlockSize, n);
+        int end = min((chunk+1)*numBlocks/numChunks*LaRank::kEvalBlockSize, n);
+        m_pLearner->Eval(sample, start, end, scores);
+
+        double chunkBestScore = -DBL_MAX;
+        for (int i = start; i < end; ++i)
+        {
+            if (scores[i] > chunkBestScore)
+            {
+                chunkBestScore = scores[i];
+                chunkBestInds[chunk] = i;
+            }
+        }
+    });
+
+    // reduce in chunk order so ties resolve exactly as in a serial scan
+    double bestScore = -DBL_MAX;
+    int bestInd = -1;
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+        int i = chunkBestInds[chunk];
+        if (i != -1 && scores[i] > bestScore)
+        {
+            bestScore = scores[i];
+            bestInd = i;
+        }
     }
 
-    MultiSample sample(image, keptRects);
+    Move(image, keptRects, scores, bestInd);
+}
+
+void Tracker::Track(const ImageRep& image, const vector<FloatRect>& rects, const vector<FeatureMatrix>& shared, const vector<int>& rows)
+{
+    assert(m_initialised);
+    assert(rows.size() == rects.size());
 
     vector<double> scores;
-    m_pLearner->Eval(sample, scores);
+    MultiSample sample(image, rects);
+    m_pLearner->Eval(sample, shared, rows, scores);
 
     double bestScore = -DBL_MAX;
     int bestInd = -1;
-    for (std::vector<double>::size_type i = 0; i < scores.size(); ++i)
+    for (int i = 0; i < (int)scores.size(); ++i)
     {
         if (scores[i] > bestScore)
         {
@@ -182,14 +356,22 @@ void Tracker::Track(const cv::Mat& frame)
         }
     }
 
-    UpdateDebugImage(keptRects, m_bb, scores);
+    Move(image, rects, scores, bestInd);
+}
+
+void Tracker::Move(const ImageRep& image, const vector<FloatRect>& rects, const vector<double>& scores, int bestInd)
+{
+    if (!scores.empty())
+    {
+        UpdateDebugImage(rects, m_bb, scores);
+    }
 
     if (bestInd != -1)
     {
-        m_bb = keptRects[bestInd];
+        m_bb = rects[bestInd];
         UpdateLearner(image);
 #if VERBOSE
-        cout << "track score: " << bestScore << endl;
+        cout << "track score: " << scores[bestInd] << endl;
 #endif
     }
 }
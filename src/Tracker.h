@@ -28,8 +28,10 @@
 #ifndef TRACKER_H
 #define TRACKER_H
 
+#include "FeatureTypes.h"
 #include "Rect.h"
 
+#include <random>
 #include <vector>
 #include <Eigen/Core>
 #include <opencv/cv.h>
@@ -39,6 +41,7 @@ class Features;
 class Kernel;
 class LaRank;
 class ImageRep;
+class ThreadPool;
 
 class Tracker
 {
@@ -47,12 +50,27 @@ public:
     ~Tracker();
 
     void Initialise(const cv::Mat& frame, FloatRect bb);
+    void Initialise(const ImageRep& image, FloatRect bb);
     void Reset();
     void Track(const cv::Mat& frame);
+    void Track(const ImageRep& image);
     void Debug();
 
+    // the part of the next frame that Track reads
+    IntRect GetTrackRegion() const;
+    // the candidate windows searched by the next Track, clipped to image
+    void GetCandidates(const ImageRep& image, std::vector<FloatRect>& rects) const;
+    // track the candidates from GetCandidates, reusing features computed
+    // elsewhere as laid out for LaRank::Eval; scoring runs on the calling
+    // thread, so several trackers can be stepped concurrently
+    void Track(const ImageRep& image, const std::vector<FloatRect>& rects,
+               const std::vector<FeatureMatrix>& shared, const std::vector<int>& rows);
+
     inline const FloatRect& GetBB() const { return m_bb; }
     inline bool IsInitialised() const { return m_initialised; }
+    inline const Features& GetFeatures() const { return *m_features.back(); }
+    inline bool NeedsIntegralImage() const { return m_needsIntegralImage; }
+    inline bool NeedsIntegralHist() const { return m_needsIntegralHist; }
 
 private:
     const Config& m_config;
@@ -60,12 +78,19 @@ private:
     std::vector<Features*> m_features;
     std::vector<Kernel*> m_kernels;
     LaRank* m_pLearner;
+    // rebuilt in place for each frame
+    ImageRep* m_pImage;
+    ThreadPool* m_pThreadPool;
+    // each tracker has its own random number generator, so that trackers
+    // can run concurrently and reproducibly
+    std::mt19937 m_rng;
     FloatRect m_bb;
     cv::Mat m_debugImage;
     bool m_needsIntegralImage;
     bool m_needsIntegralHist;
 
     void UpdateLearner(const ImageRep& image);
+    void Move(const ImageRep& image, const std::vector<FloatRect>& rects, const std::vector<double>& scores, int bestInd);
     void UpdateDebugImage(const std::vector<FloatRect>& samples, const FloatRect& centre, const std::vector<double>& scores);
 };
 
@@ -166,7 +166,6 @@ int main(int argc, char* argv[])
     Mat result(conf.frameHeight, conf.frameWidth, CV_8UC3);
     bool paused = false;
     bool doInitialise = false;
-    srand(conf.seed);
     for (int frameInd = startFrame; frameInd <= endFrame; ++frameInd)
     {
         Mat frame;